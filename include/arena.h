@@ -0,0 +1,88 @@
+#pragma once
+#include "pre_define.h"
+
+namespace LANG_NS
+{
+    // bump allocator for objects that die together, like the tokens and syntax tree of one compilation
+    //  - memory comes from large blocks that are only released with the arena
+    //  - objects with a non trivial destructor are destroyed in reverse order when the arena goes away
+    class Arena : NoCopyable
+    {
+    public:
+        Arena() = default;
+
+        ~Arena()
+        {
+            for (auto iter = _destructors.rbegin(); iter != _destructors.rend(); ++iter)
+            {
+                iter->destroy(iter->object);
+            }
+            for (auto iter = _blocks.begin(); iter != _blocks.end(); ++iter)
+            {
+                ::operator delete(*iter);
+            }
+        }
+
+        void* Allocate(SizeT size, SizeT align)
+        {
+            auto pos = (_current + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+            if (pos + size > _end)
+            {
+                NewBlock(size + align);
+                pos = (_current + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+            }
+            _current = pos + size;
+            return reinterpret_cast<void*>(pos);
+        }
+
+        template < typename T, typename... Args >
+        T* New(Args&&... args)
+        {
+            auto object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if (!std::is_trivially_destructible<T>::value)
+            {
+                _destructors.push_back(Destructor{ object, &Destroy<T> });
+            }
+            return object;
+        }
+
+        // bytes taken from the system so far
+        SizeT Capacity() const
+        {
+            return _capacity;
+        }
+
+    private:
+        static constexpr SizeT BlockSize = 64 * 1024;
+
+        class Destructor
+        {
+        public:
+            void* object;
+            void (*destroy)(void*);
+        };
+
+        template < typename T >
+        static void Destroy(void* object)
+        {
+            static_cast<T*>(object)->~T();
+        }
+
+        void NewBlock(SizeT min_size)
+        {
+            auto size = std::max(BlockSize, min_size);
+            auto block = ::operator new(size);
+            _blocks.push_back(block);
+            _current = reinterpret_cast<std::uintptr_t>(block);
+            _end = _current + size;
+            _capacity += size;
+        }
+
+    private:
+        TVector<void*> _blocks;
+        TVector<Destructor> _destructors;
+        std::uintptr_t _current = 0;
+        std::uintptr_t _end = 0;
+        SizeT _capacity = 0;
+    };
+}
@@ -0,0 +1,302 @@
+#pragma once
+#include "pre_define.h"
+#include "value.h"
+
+namespace LANG_NS
+{
+    namespace Bytecode
+    {
+        // R(x) : register x of the current frame
+        // K(x) : constant x of the current proto
+        // P(x) : child proto x of the current proto
+        // S(x) : the scope x levels up from the current one, S(0) is the current scope
+        // top  : end of the last open (variable count) value list
+        #define OPCODE_MAKER(xx) \
+            xx(Move)            /* A B     R(A) = R(B) */ \
+            xx(LoadK)           /* A Bx    R(A) = K(Bx) */ \
+            xx(LoadNil)         /* A B     R(A) ... R(A+B-1) = nil */ \
+            xx(LoadArgs)        /* A       R(A) = array of all call params */ \
+            xx(GetGlobal)       /* A Bx    R(A) = globals[K(Bx)] */ \
+            xx(SetGlobal)       /* A Bx    globals[K(Bx)] = R(A) */ \
+            xx(GetUpval)        /* A B C   R(A) = S(B)[C] */ \
+            xx(SetUpval)        /* A B C   S(B)[C] = R(A) */ \
+            xx(PushScope)       /* A       enter a new scope of A slots */ \
+            xx(PopScope)        /* A       leave A scopes */ \
+            xx(Closure)         /* A Bx    R(A) = function of P(Bx) closed over the current scope */ \
+            xx(NewArray)        /* A B     R(A) = [R(A+1) ... R(A+B-1)], B == 0 : up to top */ \
+            xx(NewDict)         /* A B     R(A) = {R(A+1) = R(A+B+1), ... R(A+B) = R(A+2B)} */ \
+            xx(SetMember)       /* A B C   R(A)[R(B)] = R(C) */ \
+            xx(GetMember)       /* A B C   R(A) = R(B)[R(C)] */ \
+            xx(BitwiseAnd)      /* A B C   R(A) = R(B) op R(C) */ \
+            xx(And) \
+            xx(BitwiseOr) \
+            xx(Or) \
+            xx(Xor) \
+            xx(Add) \
+            xx(Sub) \
+            xx(Mul) \
+            xx(Div) \
+            xx(Mod) \
+            xx(Pow) \
+            xx(Equel) \
+            xx(Greater) \
+            xx(GreaterEquel) \
+            xx(Less) \
+            xx(LessEquel) \
+            xx(NotEquel) \
+            xx(BitwiseNot)      /* A B     R(A) = op R(B) */ \
+            xx(Not) \
+            xx(Positive) \
+            xx(Negative) \
+            xx(Call)            /* A B C   R(A) ... R(A+C-2) = R(A)(R(A+1) ... R(A+B-1)), B == 0 : up to top, C == 0 : open */ \
+            xx(Return)          /* A B     return R(A) ... R(A+B-2), B == 0 : up to top */ \
+            xx(MoveList)        /* A B     R(A) ... = R(B) ... R(top-1), top = A + top - B */ \
+            xx(SetTop)          /* A       top = A */ \
+            xx(Adjust)          /* A B     R(top) ... R(A+B-1) = nil */ \
+            xx(Jmp)             /* sBx     pc += sBx */ \
+            xx(JmpIfNot)        /* A sBx   if not R(A) then pc += sBx */ \
+            xx(ForPrep)         /* A sBx   check R(A) is iterable, reset iteration state, pc += sBx */ \
+            xx(ForLoop)         /* A sBx   R(A+2), R(A+3) = next item of R(A) after state R(A+1), if any then pc += sBx */
+
+        #define OPCODE_2ENUM(op) op,
+        #define OPCODE_2STR(op) {OpCode::op, U"" #op},
+        #define OPCODE_2COUNT(op) + 1
+
+        enum class OpCode : uint16_t
+        {
+            OPCODE_MAKER(OPCODE_2ENUM)
+        };
+
+        static constexpr SizeT OpCodeCount = 0 OPCODE_MAKER(OPCODE_2COUNT);
+
+        static const StringT& OpCodeName(OpCode op)
+        {
+            static const TMap<OpCode, StringT> _op_names = {
+                OPCODE_MAKER(OPCODE_2STR)
+            };
+            return _op_names.find(op)->second;
+        }
+
+        #undef OPCODE_2COUNT
+        #undef OPCODE_2STR
+        #undef OPCODE_2ENUM
+        #undef OPCODE_MAKER
+
+        static const ValueData& OperatorFunctionName(OpCode op)
+        {
+            static const TMap<OpCode, ValueData> _func_names = {
+                {OpCode::GetMember, Value::Data::Intern(U"__get_member")},
+                {OpCode::BitwiseAnd, Value::Data::Intern(U"__bitwise_and")},
+                {OpCode::And, Value::Data::Intern(U"__and")},
+                {OpCode::BitwiseOr, Value::Data::Intern(U"__bitwise_or")},
+                {OpCode::Or, Value::Data::Intern(U"__or")},
+                {OpCode::Xor, Value::Data::Intern(U"__xor")},
+                {OpCode::Add, Value::Data::Intern(U"__add")},
+                {OpCode::Sub, Value::Data::Intern(U"__sub")},
+                {OpCode::Mul, Value::Data::Intern(U"__mul")},
+                {OpCode::Div, Value::Data::Intern(U"__div")},
+                {OpCode::Mod, Value::Data::Intern(U"__mod")},
+                {OpCode::Pow, Value::Data::Intern(U"__pow")},
+                {OpCode::Equel, Value::Data::Intern(U"__equel")},
+                {OpCode::Greater, Value::Data::Intern(U"__greater")},
+                {OpCode::GreaterEquel, Value::Data::Intern(U"__greater_equel")},
+                {OpCode::Less, Value::Data::Intern(U"__less")},
+                {OpCode::LessEquel, Value::Data::Intern(U"__less_equel")},
+                {OpCode::NotEquel, Value::Data::Intern(U"__not_equel")},
+                {OpCode::BitwiseNot, Value::Data::Intern(U"__bitwise_not")},
+                {OpCode::Not, Value::Data::Intern(U"__not")},
+                {OpCode::Positive, Value::Data::Intern(U"__positive")},
+                {OpCode::Negative, Value::Data::Intern(U"__negative")},
+            };
+            auto iter = _func_names.find(op);
+            Assert(iter != _func_names.end());
+            return iter->second;
+        }
+
+        static Option<OpCode> BinaryOpCode(ETokenType t)
+        {
+            static const TMap<ETokenType, OpCode> _op_codes = {
+                {ETokenType::BitwiseAnd, OpCode::BitwiseAnd},
+                {ETokenType::And, OpCode::And},
+                {ETokenType::BitwiseOr, OpCode::BitwiseOr},
+                {ETokenType::Or, OpCode::Or},
+                {ETokenType::Xor, OpCode::Xor},
+                {ETokenType::Add, OpCode::Add},
+                {ETokenType::Sub, OpCode::Sub},
+                {ETokenType::Mul, OpCode::Mul},
+                {ETokenType::Div, OpCode::Div},
+                {ETokenType::Mod, OpCode::Mod},
+                {ETokenType::Pow, OpCode::Pow},
+                {ETokenType::Equel, OpCode::Equel},
+                {ETokenType::Greater, OpCode::Greater},
+                {ETokenType::GreaterEquel, OpCode::GreaterEquel},
+                {ETokenType::Less, OpCode::Less},
+                {ETokenType::LessEquel, OpCode::LessEquel},
+                {ETokenType::NotEquel, OpCode::NotEquel},
+                {ETokenType::LeftSquareBrace, OpCode::GetMember},
+            };
+            auto iter = _op_codes.find(t);
+            if (iter == _op_codes.end())
+            {
+                return Option<OpCode>();
+            }
+            return iter->second;
+        }
+
+        static Option<OpCode> UnaryOpCode(ETokenType t)
+        {
+            static const TMap<ETokenType, OpCode> _op_codes = {
+                {ETokenType::BitwiseNot, OpCode::BitwiseNot},
+                {ETokenType::Not, OpCode::Not},
+                {ETokenType::Add, OpCode::Positive},
+                {ETokenType::Sub, OpCode::Negative},
+            };
+            auto iter = _op_codes.find(t);
+            if (iter == _op_codes.end())
+            {
+                return Option<OpCode>();
+            }
+            return iter->second;
+        }
+
+        class Instruction
+        {
+        public:
+            static Instruction ABC(OpCode op, SizeT a, SizeT b = 0, SizeT c = 0)
+            {
+                Assert(a <= 0xFFFF && b <= 0xFFFF && c <= 0xFFFF);
+                return Instruction(op, a, static_cast<uint32_t>(b | (c << 16)));
+            }
+
+            static Instruction ABx(OpCode op, SizeT a, SizeT bx)
+            {
+                Assert(a <= 0xFFFF && bx <= 0xFFFFFFFF);
+                return Instruction(op, a, static_cast<uint32_t>(bx));
+            }
+
+            static Instruction AsBx(OpCode op, SizeT a, int sbx)
+            {
+                Assert(a <= 0xFFFF);
+                return Instruction(op, a, static_cast<uint32_t>(sbx));
+            }
+
+            OpCode Op() const
+            {
+                return _op;
+            }
+
+            SizeT A() const
+            {
+                return _a;
+            }
+
+            SizeT B() const
+            {
+                return _bx & 0xFFFF;
+            }
+
+            SizeT C() const
+            {
+                return _bx >> 16;
+            }
+
+            SizeT Bx() const
+            {
+                return _bx;
+            }
+
+            int SBx() const
+            {
+                return static_cast<int>(_bx);
+            }
+
+            void SetSBx(int sbx)
+            {
+                _bx = static_cast<uint32_t>(sbx);
+            }
+
+            // packed form saved in bytecode images
+            uint64_t Bits() const
+            {
+                return static_cast<uint64_t>(_op) | (static_cast<uint64_t>(_a) << 16) | (static_cast<uint64_t>(_bx) << 32);
+            }
+
+            static Option<Instruction> FromBits(uint64_t bits)
+            {
+                auto op = static_cast<SizeT>(bits & 0xFFFF);
+                if (op >= OpCodeCount)
+                {
+                    return Option<Instruction>();
+                }
+                return Instruction(static_cast<OpCode>(op), (bits >> 16) & 0xFFFF, static_cast<uint32_t>(bits >> 32));
+            }
+
+        private:
+            Instruction(OpCode op, SizeT a, uint32_t bx)
+                : _op(op)
+                , _a(static_cast<uint16_t>(a))
+                , _bx(bx)
+            {}
+
+        private:
+            OpCode _op;
+            uint16_t _a;
+            uint32_t _bx;
+        };
+        StaticAssert(sizeof(Instruction) == 8, "Instruction must be 8 bytes");
+
+        class Proto
+        {
+        public:
+            StringT name;
+            StringT module_name;
+            SizeT param_count = 0;
+            SizeT max_stack = 0;
+            TVector<Instruction> code;
+            TVector<ValuePtr> constants;
+            TVector<SharedPtr<Proto>> protos;
+        };
+
+        using ProtoPtr = SharedPtr<Proto>;
+
+        static void DebugPrint(const ProtoPtr& proto, SizeT tab = 0)
+        {
+            using std::cout;
+            using std::endl;
+            cout << std::string(tab, '\t') << "[Proto] " << proto->name << " in module " << proto->module_name
+                << " params = " << proto->param_count << " max_stack = " << proto->max_stack << endl;
+            for (SizeT i = 0; i < proto->constants.size(); ++i)
+            {
+                cout << std::string(tab, '\t') << "K(" << i << ") = " << proto->constants[i]->ToString() << endl;
+            }
+            for (SizeT i = 0; i < proto->code.size(); ++i)
+            {
+                const auto& ins = proto->code[i];
+                cout << std::string(tab, '\t') << i << "\t" << OpCodeName(ins.Op()) << "\t" << ins.A() << "\t";
+                switch (ins.Op())
+                {
+                case OpCode::LoadK:
+                case OpCode::GetGlobal:
+                case OpCode::SetGlobal:
+                case OpCode::Closure:
+                    cout << ins.Bx();
+                    break;
+                case OpCode::Jmp:
+                case OpCode::JmpIfNot:
+                case OpCode::ForPrep:
+                case OpCode::ForLoop:
+                    cout << ins.SBx() << "\t; to " << static_cast<long long>(i) + 1 + ins.SBx();
+                    break;
+                default:
+                    cout << ins.B() << "\t" << ins.C();
+                    break;
+                }
+                cout << endl;
+            }
+            for (auto iter = proto->protos.begin(); iter != proto->protos.end(); ++iter)
+            {
+                DebugPrint(*iter, tab + 1);
+            }
+        }
+    }
+}
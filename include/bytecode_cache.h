@@ -0,0 +1,479 @@
+#pragma once
+#include <cstdio>
+#include <fstream>
+#include "bytecode.h"
+#include "pre_define.h"
+#include "unicode.h"
+#include "unicode_helper.h"
+#include "unicode_reader.h"
+
+namespace LANG_NS
+{
+    namespace Bytecode
+    {
+        // compiled chunks saved next to their source, module.sno -> module.snoc
+        //  - the header holds the image format, the opcode count and a key hashed from the source bytes
+        //    and the interpreter build, an image that does not match is ignored and rewritten
+        //  - operands are checked on load, a damaged image is rejected instead of indexing out of the frame
+        //  - images are mapped and decoded in place, writes go to a temporary file renamed over the old image
+        //  - module names are not saved, they come from the path the source is loaded by
+        //  - only regular files that can be mapped are cached
+        class Cache
+        {
+        public:
+            // raised whenever the image layout or the code the compiler emits changes
+            static constexpr uint32_t FormatVersion = 2;
+
+            // hash of the source bytes and of the settings the compiled code depends on
+            static Option<uint64_t> SourceKey(const StringT& file_name, bool fold_operators)
+            {
+                Unicode::MappedFile source(Unicode::Encode(file_name, Unicode::FormatType::ANSI));
+                if (!source.Data())
+                {
+                    return Option<uint64_t>();
+                }
+                // ansi sources decode differently under another locale
+                uint64_t seed = (fold_operators ? 1 : 0) | (Unicode::Helper::IsUtf8Locale() ? 2 : 0);
+                // another build may emit other code without anyone raising FormatVersion
+                seed ^= BuildStamp() << 2;
+                return Hash(reinterpret_cast<const unsigned char*>(source.Data()), source.Size(), seed);
+            }
+
+            static ProtoPtr Load(const StringT& file_name, uint64_t key)
+            {
+                Unicode::MappedFile image(ImagePath(file_name));
+                if (!image.Data())
+                {
+                    return nullptr;
+                }
+                try
+                {
+                    Reader reader(image.Data(), image.Size());
+                    if (
+                        reader.Bytes(Magic().size()) != Magic()
+                        || reader.U32() != FormatVersion
+                        || reader.U32() != EndianMark
+                        || reader.U32() != OpCodeCount
+                        || reader.U64() != key
+                    )
+                    {
+                        return nullptr;
+                    }
+                    auto proto = ReadProto(reader, file_name);
+                    return reader.AtEnd() ? proto : nullptr;
+                }
+                catch (const Exception&)
+                {
+                    return nullptr;
+                }
+            }
+
+            // best effort, an unwritable directory only costs the next load a compile
+            static void Save(const StringT& file_name, uint64_t key, const ProtoPtr& proto)
+            {
+                BytesT image(Magic());
+                PutU32(image, FormatVersion);
+                PutU32(image, EndianMark);
+                PutU32(image, static_cast<uint32_t>(OpCodeCount));
+                PutU64(image, key);
+                WriteProto(image, proto);
+
+                auto path = ImagePath(file_name);
+                auto temp_path = path + ".tmp" + TempSuffix();
+                {
+                    std::ofstream ofs(temp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+                    if (!ofs.write(image.data(), image.size()).flush())
+                    {
+                        ofs.close();
+                        (void)std::remove(temp_path.c_str());
+                        return;
+                    }
+                }
+                if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+                {
+                    (void)std::remove(temp_path.c_str());
+                }
+            }
+
+        private:
+            static constexpr uint32_t EndianMark = 0x01020304;
+
+            enum class ConstantTag : uint8_t
+            {
+                Nil = 0,
+                Bool,
+                Int,
+                Float,
+                String,
+            };
+
+            class Reader
+            {
+            public:
+                Reader(const ByteT* data, SizeT size)
+                    : _pos(data)
+                    , _end(data + size)
+                {}
+
+                BytesT Bytes(SizeT size)
+                {
+                    return BytesT(Take(size), size);
+                }
+
+                uint8_t U8()
+                {
+                    return static_cast<uint8_t>(*Take(1));
+                }
+
+                uint32_t U32()
+                {
+                    uint32_t v;
+                    memcpy(&v, Take(sizeof(v)), sizeof(v));
+                    return v;
+                }
+
+                uint64_t U64()
+                {
+                    uint64_t v;
+                    memcpy(&v, Take(sizeof(v)), sizeof(v));
+                    return v;
+                }
+
+                StringT String()
+                {
+                    auto size = U32();
+                    StringT s(size, 0);
+                    if (size > 0)
+                    {
+                        memcpy(&s[0], Take(size * sizeof(CharT)), size * sizeof(CharT));
+                    }
+                    return s;
+                }
+
+                bool AtEnd() const
+                {
+                    return _pos == _end;
+                }
+
+            private:
+                const ByteT* Take(SizeT size)
+                {
+                    if (static_cast<SizeT>(_end - _pos) < size)
+                    {
+                        throw(Exception(U"Truncated bytecode image"));
+                    }
+                    auto pos = _pos;
+                    _pos += size;
+                    return pos;
+                }
+
+            private:
+                const ByteT* _pos;
+                const ByteT* _end;
+            };
+
+            static const BytesT& Magic()
+            {
+                static const BytesT _magic = "SNOC";
+                return _magic;
+            }
+
+            static BytesT ImagePath(const StringT& file_name)
+            {
+                return Unicode::Encode(file_name, Unicode::FormatType::ANSI) + "c";
+            }
+
+            static BytesT TempSuffix()
+            {
+#if defined(__linux__)
+                return std::to_string(getpid());
+#else
+                return BytesT();
+#endif
+            }
+
+            static uint64_t BuildStamp()
+            {
+                static const char _stamp[] = __DATE__ " " __TIME__;
+                static const uint64_t _hash = Hash(reinterpret_cast<const unsigned char*>(_stamp), sizeof(_stamp) - 1, 0);
+                return _hash;
+            }
+
+            static uint64_t Hash(const unsigned char* data, SizeT size, uint64_t seed)
+            {
+                const uint64_t k = 0x9E3779B97F4A7C15ull;
+                uint64_t h = (seed + size) * k;
+                SizeT i = 0;
+                for (; i + 8 <= size; i += 8)
+                {
+                    uint64_t w;
+                    memcpy(&w, data + i, sizeof(w));
+                    h = ((h ^ w) * k);
+                    h ^= h >> 29;
+                }
+                uint64_t tail = 0;
+                for (SizeT shift = 0; i < size; ++i, shift += 8)
+                {
+                    tail |= static_cast<uint64_t>(data[i]) << shift;
+                }
+                h = (h ^ tail) * k;
+                h ^= h >> 32;
+                return h;
+            }
+
+            static void PutU8(BytesT& out, uint8_t v)
+            {
+                out.push_back(static_cast<ByteT>(v));
+            }
+
+            static void PutU32(BytesT& out, uint32_t v)
+            {
+                out.append(reinterpret_cast<const ByteT*>(&v), sizeof(v));
+            }
+
+            static void PutU64(BytesT& out, uint64_t v)
+            {
+                out.append(reinterpret_cast<const ByteT*>(&v), sizeof(v));
+            }
+
+            static void PutString(BytesT& out, const StringT& s)
+            {
+                PutU32(out, static_cast<uint32_t>(s.size()));
+                out.append(reinterpret_cast<const ByteT*>(s.data()), s.size() * sizeof(CharT));
+            }
+
+            static void WriteProto(BytesT& out, const ProtoPtr& proto)
+            {
+                PutString(out, proto->name);
+                PutU32(out, static_cast<uint32_t>(proto->param_count));
+                PutU32(out, static_cast<uint32_t>(proto->max_stack));
+                PutU32(out, static_cast<uint32_t>(proto->code.size()));
+                for (auto iter = proto->code.begin(); iter != proto->code.end(); ++iter)
+                {
+                    PutU64(out, iter->Bits());
+                }
+                PutU32(out, static_cast<uint32_t>(proto->constants.size()));
+                for (auto iter = proto->constants.begin(); iter != proto->constants.end(); ++iter)
+                {
+                    switch ((*iter)->GetType())
+                    {
+                    case Value::EType::Nil:
+                        PutU8(out, static_cast<uint8_t>(ConstantTag::Nil));
+                        break;
+                    case Value::EType::Bool:
+                        PutU8(out, static_cast<uint8_t>(ConstantTag::Bool));
+                        PutU8(out, (*iter)->BoolValue() ? 1 : 0);
+                        break;
+                    case Value::EType::Int:
+                        PutU8(out, static_cast<uint8_t>(ConstantTag::Int));
+                        PutU64(out, static_cast<uint64_t>((*iter)->IntValue()));
+                        break;
+                    case Value::EType::Float:
+                    {
+                        auto f = (*iter)->FloatValue();
+                        uint64_t bits;
+                        memcpy(&bits, &f, sizeof(bits));
+                        PutU8(out, static_cast<uint8_t>(ConstantTag::Float));
+                        PutU64(out, bits);
+                        break;
+                    }
+                    case Value::EType::String:
+                        PutU8(out, static_cast<uint8_t>(ConstantTag::String));
+                        PutString(out, (*iter)->StringValue());
+                        break;
+                    default:
+                        throw(Exception(U"Constant cannot be saved"));
+                    }
+                }
+                PutU32(out, static_cast<uint32_t>(proto->protos.size()));
+                for (auto iter = proto->protos.begin(); iter != proto->protos.end(); ++iter)
+                {
+                    WriteProto(out, *iter);
+                }
+            }
+
+            static ProtoPtr ReadProto(Reader& reader, const StringT& module_name)
+            {
+                auto proto = MakeShared<Proto>();
+                proto->name = reader.String();
+                proto->module_name = module_name;
+                proto->param_count = reader.U32();
+                proto->max_stack = reader.U32();
+                auto code_size = reader.U32();
+                proto->code.reserve(code_size);
+                for (uint32_t i = 0; i < code_size; ++i)
+                {
+                    auto ins = Instruction::FromBits(reader.U64());
+                    if (!ins)
+                    {
+                        throw(Exception(U"Invalid opcode in bytecode image"));
+                    }
+                    proto->code.push_back(*ins);
+                }
+                auto constant_size = reader.U32();
+                proto->constants.reserve(constant_size);
+                for (uint32_t i = 0; i < constant_size; ++i)
+                {
+                    switch (static_cast<ConstantTag>(reader.U8()))
+                    {
+                    case ConstantTag::Nil:
+                        proto->constants.push_back(Value::New());
+                        break;
+                    case ConstantTag::Bool:
+                        proto->constants.push_back(Value::New(reader.U8() != 0));
+                        break;
+                    case ConstantTag::Int:
+                        proto->constants.push_back(Value::New(static_cast<IntT>(reader.U64())));
+                        break;
+                    case ConstantTag::Float:
+                    {
+                        auto bits = reader.U64();
+                        FloatT f;
+                        memcpy(&f, &bits, sizeof(f));
+                        proto->constants.push_back(Value::New(f));
+                        break;
+                    }
+                    case ConstantTag::String:
+                        // the compiler interns every string constant
+                        proto->constants.push_back(Value::Data::Intern(reader.String()));
+                        break;
+                    default:
+                        throw(Exception(U"Invalid constant in bytecode image"));
+                    }
+                }
+                auto proto_size = reader.U32();
+                for (uint32_t i = 0; i < proto_size; ++i)
+                {
+                    proto->protos.push_back(ReadProto(reader, module_name));
+                }
+                CheckOperands(proto);
+                return proto;
+            }
+
+            // the executor trusts every operand, registers must lie inside the frame,
+            // constant and proto indexes inside the proto and jumps inside the code
+            //  - operands counting up to top are checked against the frame as far as they are fixed
+            static void CheckOperands(const ProtoPtr& proto)
+            {
+                auto frame = proto->max_stack;
+                if (proto->param_count > frame || proto->code.empty() || proto->code.back().Op() != OpCode::Return)
+                {
+                    throw(Exception(U"Invalid proto in bytecode image"));
+                }
+                for (SizeT i = 0; i < proto->code.size(); ++i)
+                {
+                    const auto& ins = proto->code[i];
+                    auto a = ins.A();
+                    auto b = ins.B();
+                    auto c = ins.C();
+                    // one past the last register the instruction touches
+                    SizeT end = a + 1;
+                    switch (ins.Op())
+                    {
+                    case OpCode::Move:
+                    case OpCode::BitwiseNot:
+                    case OpCode::Not:
+                    case OpCode::Positive:
+                    case OpCode::Negative:
+                        end = std::max(a, b) + 1;
+                        break;
+                    case OpCode::LoadK:
+                    case OpCode::GetGlobal:
+                    case OpCode::SetGlobal:
+                        if (ins.Bx() >= proto->constants.size())
+                        {
+                            throw(Exception(U"Invalid constant index in bytecode image"));
+                        }
+                        break;
+                    case OpCode::Closure:
+                        if (ins.Bx() >= proto->protos.size())
+                        {
+                            throw(Exception(U"Invalid proto index in bytecode image"));
+                        }
+                        break;
+                    case OpCode::LoadNil:
+                    case OpCode::Adjust:
+                        end = a + b;
+                        break;
+                    case OpCode::PushScope:
+                    case OpCode::PopScope:
+                        end = 0;
+                        break;
+                    case OpCode::NewArray:
+                        end = std::max(a + 1, a + b);
+                        break;
+                    case OpCode::NewDict:
+                        end = a + 2 * b + 1;
+                        break;
+                    case OpCode::SetMember:
+                    case OpCode::GetMember:
+                    case OpCode::BitwiseAnd:
+                    case OpCode::And:
+                    case OpCode::BitwiseOr:
+                    case OpCode::Or:
+                    case OpCode::Xor:
+                    case OpCode::Add:
+                    case OpCode::Sub:
+                    case OpCode::Mul:
+                    case OpCode::Div:
+                    case OpCode::Mod:
+                    case OpCode::Pow:
+                    case OpCode::Equel:
+                    case OpCode::Greater:
+                    case OpCode::GreaterEquel:
+                    case OpCode::Less:
+                    case OpCode::LessEquel:
+                    case OpCode::NotEquel:
+                        end = std::max({a, b, c}) + 1;
+                        break;
+                    case OpCode::Call:
+                        end = std::max({a + 1, a + b, a + c - (c > 0 ? 1 : 0)});
+                        break;
+                    case OpCode::Return:
+                        end = b == 0 ? a : a + b - 1;
+                        break;
+                    case OpCode::MoveList:
+                        end = std::max(a, b);
+                        break;
+                    case OpCode::SetTop:
+                        end = a;
+                        break;
+                    case OpCode::Jmp:
+                        end = 0;
+                        break;
+                    case OpCode::ForPrep:
+                        end = a + 2;
+                        break;
+                    case OpCode::ForLoop:
+                        end = a + 4;
+                        break;
+                    default:
+                        break;
+                    }
+                    if (end > frame)
+                    {
+                        throw(Exception(U"Invalid register in bytecode image"));
+                    }
+                    switch (ins.Op())
+                    {
+                    case OpCode::Jmp:
+                    case OpCode::JmpIfNot:
+                    case OpCode::ForPrep:
+                    case OpCode::ForLoop:
+                    {
+                        // pc has moved past the instruction when the jump is taken
+                        auto target = static_cast<long long>(i) + 1 + ins.SBx();
+                        if (target < 0 || target >= static_cast<long long>(proto->code.size()))
+                        {
+                            throw(Exception(U"Invalid jump in bytecode image"));
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                    }
+                }
+            }
+        };
+    }
+}
@@ -0,0 +1,1112 @@
+#pragma once
+#include "bytecode.h"
+#include "pre_define.h"
+#include "resolver.h"
+#include "syntax_tree.h"
+
+namespace LANG_NS
+{
+    class Compiler
+    {
+    public:
+        explicit Compiler(const StringT& module_name)
+            : _module_name(module_name)
+        {
+
+        }
+
+        Bytecode::ProtoPtr Compile(const SyntaxTree::NodePtr& node)
+        {
+            if (!node || node->node_type != SyntaxTree::NodeType::Chunk)
+            {
+                Error(U"Except a chunk");
+            }
+            auto chunk = static_cast<SyntaxTree::Chunk*>(node);
+            _resolver.Resolve(node);
+            _locations.assign(_resolver.VariableCount(), Location());
+            FunctionState fs(U"<chunk>", _module_name, nullptr);
+            _fs = &fs;
+            auto scope = EnterScope(node);
+            // define params
+            auto args_reg = AllocRegisters();
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::LoadArgs, args_reg));
+            if (!DeclareVariable(U"args", args_reg))
+            {
+                FreeRegisters(args_reg);
+            }
+            // run chunk
+            CompileBlockStatements(chunk->block);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Return, 0, 1));
+            LeaveFunctionScope(scope);
+            _fs = nullptr;
+            return fs.proto;
+        }
+
+        const StringT ModuleName() const
+        {
+            return _module_name;
+        }
+
+    private:
+        static const SizeT OpenResults = static_cast<SizeT>(-1);
+
+        class LoopState
+        {
+        public:
+            SizeT scope_depth = 0;
+            TVector<SizeT> break_jumps;
+            TVector<SizeT> continue_jumps;
+        };
+
+        class ReturnTarget
+        {
+        public:
+            SizeT reg = 0;
+            SizeT scope_depth = 0;
+            TVector<SizeT> jumps;
+        };
+
+        // where a variable lives : a register of its function, or a slot of a heap scope
+        class Location
+        {
+        public:
+            bool captured = false;
+            bool bound = false;
+            SizeT index = 0;
+            SizeT heap_level = 0;
+        };
+
+        class ScopeState
+        {
+        public:
+            const SyntaxTree::NodeBase* parent = nullptr;
+            SizeT free_reg = 0;
+            bool pushed = false;
+        };
+
+        class FunctionState
+        {
+        public:
+            FunctionState(const StringT& name, const StringT& module_name, FunctionState* parent_fs)
+                : proto(MakeShared<Bytecode::Proto>())
+                , parent(parent_fs)
+            {
+                proto->name = name;
+                proto->module_name = module_name;
+            }
+
+            Bytecode::ProtoPtr proto;
+            FunctionState* parent;
+            SizeT free_reg = 0;
+            SizeT scope_depth = 0;
+            TVector<LoopState> loops;
+            TVector<ReturnTarget> return_targets;
+            TMap<ValueData, SizeT> constant_indexes;
+        };
+
+        void Error(const StringT& err_info) const
+        {
+            StringT err_msg(err_info);
+            err_msg += U" in module ";
+            err_msg += _module_name;
+            throw(Exception(err_msg));
+        }
+
+        SizeT Emit(const Bytecode::Instruction& ins)
+        {
+            _fs->proto->code.push_back(ins);
+            return _fs->proto->code.size() - 1;
+        }
+
+        SizeT EmitJump(Bytecode::OpCode op, SizeT a = 0)
+        {
+            return Emit(Bytecode::Instruction::AsBx(op, a, 0));
+        }
+
+        void PatchJump(SizeT index, SizeT target)
+        {
+            _fs->proto->code[index].SetSBx(static_cast<int>(target) - static_cast<int>(index) - 1);
+        }
+
+        void PatchJumpHere(SizeT index)
+        {
+            PatchJump(index, _fs->proto->code.size());
+        }
+
+        SizeT AllocRegisters(SizeT count = 1)
+        {
+            SizeT first = _fs->free_reg;
+            _fs->free_reg += count;
+            ReserveStack(_fs->free_reg);
+            return first;
+        }
+
+        void FreeRegisters(SizeT first)
+        {
+            Assert(first <= _fs->free_reg);
+            _fs->free_reg = first;
+        }
+
+        void ReserveStack(SizeT size)
+        {
+            if (size > 0xFFFF)
+            {
+                Error(U"Expression too complex");
+            }
+            if (size > _fs->proto->max_stack)
+            {
+                _fs->proto->max_stack = size;
+            }
+        }
+
+        SizeT Constant(const ValuePtr& v)
+        {
+            auto iter = _fs->constant_indexes.find(*v);
+            if (iter != _fs->constant_indexes.end())
+            {
+                return iter->second;
+            }
+            _fs->proto->constants.push_back(v);
+            _fs->constant_indexes[*v] = _fs->proto->constants.size() - 1;
+            return _fs->proto->constants.size() - 1;
+        }
+
+        SizeT NameConstant(const StringT& name)
+        {
+            return Constant(Value::Data::Intern(name));
+        }
+
+        void CompileBlockStatements(const SyntaxTree::NodePtr& node)
+        {
+            Assert(node->node_type == SyntaxTree::NodeType::Block);
+            auto block = static_cast<SyntaxTree::Block*>(node);
+            for (auto iter = block->statements.begin(); iter != block->statements.end(); ++iter)
+            {
+                CompileStatement(*iter);
+            }
+        }
+
+        // captured variables of the scope get slots of a heap scope, others get registers when declared
+        ScopeState EnterScope(const SyntaxTree::NodeBase* node)
+        {
+            ScopeState state;
+            state.parent = _scope;
+            state.free_reg = _fs->free_reg;
+            _scope = node;
+            SizeT slot_count = 0;
+            auto& variables = _resolver.ScopeVariables(node);
+            for (auto iter = variables.begin(); iter != variables.end(); ++iter)
+            {
+                if (!_resolver.GetVariable(*iter).captured)
+                {
+                    continue;
+                }
+                auto& location = _locations[*iter];
+                location.captured = true;
+                location.index = slot_count++;
+                location.heap_level = _heap_level + 1;
+            }
+            if (slot_count > 0)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::PushScope, slot_count));
+                ++_fs->scope_depth;
+                ++_heap_level;
+                state.pushed = true;
+            }
+            return state;
+        }
+
+        void LeaveScope(const ScopeState& state)
+        {
+            if (state.pushed)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::PopScope, 1));
+                --_fs->scope_depth;
+                --_heap_level;
+            }
+            FreeRegisters(state.free_reg);
+            _scope = state.parent;
+        }
+
+        // the scope of a function is left by its return
+        void LeaveFunctionScope(const ScopeState& state)
+        {
+            if (state.pushed)
+            {
+                --_fs->scope_depth;
+                --_heap_level;
+            }
+            _scope = state.parent;
+        }
+
+        // declares name in the current scope with the value at reg, returns true if reg is kept for it
+        bool DeclareVariable(const StringT& name, SizeT reg)
+        {
+            auto& location = _locations[_resolver.FindVariable(_scope, name)];
+            if (location.captured)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::SetUpval, reg, _heap_level - location.heap_level, location.index));
+                return false;
+            }
+            if (location.bound)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Move, location.index, reg));
+                return false;
+            }
+            location.bound = true;
+            location.index = reg;
+            return true;
+        }
+
+        void CompileLoadName(const SyntaxTree::NodeBase* node, const StringT& name, SizeT reg)
+        {
+            auto variable = _resolver.Reference(node);
+            if (!variable)
+            {
+                Emit(Bytecode::Instruction::ABx(Bytecode::OpCode::GetGlobal, reg, NameConstant(name)));
+                return;
+            }
+            auto& location = _locations[*variable];
+            if (location.captured)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::GetUpval, reg, _heap_level - location.heap_level, location.index));
+            }
+            else if (location.index != reg)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Move, reg, location.index));
+            }
+        }
+
+        void CompileStoreName(const SyntaxTree::NodeBase* node, const StringT& name, SizeT reg)
+        {
+            auto variable = _resolver.Reference(node);
+            if (!variable)
+            {
+                Emit(Bytecode::Instruction::ABx(Bytecode::OpCode::SetGlobal, reg, NameConstant(name)));
+                return;
+            }
+            auto& location = _locations[*variable];
+            if (location.captured)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::SetUpval, reg, _heap_level - location.heap_level, location.index));
+            }
+            else
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Move, location.index, reg));
+            }
+        }
+
+        // the register of a local variable the node names, if it is one
+        Option<SizeT> LocalRegister(const SyntaxTree::NodePtr& node) const
+        {
+            if (node->node_type != SyntaxTree::NodeType::Terminator)
+            {
+                return Option<SizeT>();
+            }
+            auto variable = _resolver.Reference(node);
+            if (!variable || _locations[*variable].captured)
+            {
+                return Option<SizeT>();
+            }
+            return _locations[*variable].index;
+        }
+
+        // if expressions run statements, which may assign locals while the expression is evaluated
+        bool RunsStatements(const SyntaxTree::NodePtr& node) const
+        {
+            if (!node)
+            {
+                return false;
+            }
+            switch (node->node_type)
+            {
+            case SyntaxTree::NodeType::IfStatement:
+                return true;
+            case SyntaxTree::NodeType::BinaryExpression:
+            {
+                auto expr = static_cast<SyntaxTree::BinaryExpression*>(node);
+                return RunsStatements(expr->left) || RunsStatements(expr->right);
+            }
+            case SyntaxTree::NodeType::UnaryExpression:
+                return RunsStatements(static_cast<SyntaxTree::UnaryExpression*>(node)->expr);
+            case SyntaxTree::NodeType::ConditionalExpression:
+            {
+                auto expr = static_cast<SyntaxTree::ConditionalExpression*>(node);
+                return RunsStatements(expr->expr) || RunsStatements(expr->true_expr) || RunsStatements(expr->false_expr);
+            }
+            case SyntaxTree::NodeType::CallStatement:
+            {
+                auto statement = static_cast<SyntaxTree::CallStatement*>(node);
+                return RunsStatements(statement->func) || RunsStatements(statement->expr_list);
+            }
+            case SyntaxTree::NodeType::ArrayStatement:
+                return RunsStatements(static_cast<SyntaxTree::ArrayStatement*>(node)->expr_list);
+            case SyntaxTree::NodeType::MapStatement:
+            {
+                auto statement = static_cast<SyntaxTree::MapStatement*>(node);
+                return RunsStatements(statement->key_expr_list) || RunsStatements(statement->val_expr_list);
+            }
+            case SyntaxTree::NodeType::ExpressionList:
+            {
+                auto& exprs = static_cast<SyntaxTree::ExpressionList*>(node)->exprs;
+                for (auto iter = exprs.begin(); iter != exprs.end(); ++iter)
+                {
+                    if (RunsStatements(*iter))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            default:
+                return false;
+            }
+        }
+
+        // a local is used in place, anything else is evaluated into reg
+        SizeT CompileToAnyReg(const SyntaxTree::NodePtr& node, SizeT reg)
+        {
+            auto local = LocalRegister(node);
+            if (local)
+            {
+                return *local;
+            }
+            CompileExpr(node, reg);
+            return reg;
+        }
+
+        void CompileScopedBlock(const SyntaxTree::NodePtr& node)
+        {
+            auto scope = EnterScope(node);
+            CompileBlockStatements(node);
+            LeaveScope(scope);
+        }
+
+        void CompileStatement(const SyntaxTree::NodePtr& node)
+        {
+            switch (node->node_type)
+            {
+            case SyntaxTree::NodeType::Block:
+                CompileScopedBlock(node);
+                break;
+            case SyntaxTree::NodeType::VarNameListStatement:
+                CompileVarNameListStatement(node);
+                break;
+            case SyntaxTree::NodeType::AssignmentStatement:
+                CompileAssignmentStatement(node);
+                break;
+            case SyntaxTree::NodeType::WhileStatement:
+                CompileWhileStatement(node);
+                break;
+            case SyntaxTree::NodeType::ForStatement:
+                CompileForStatement(node);
+                break;
+            case SyntaxTree::NodeType::BreakStatement:
+                CompileBreakStatement();
+                break;
+            case SyntaxTree::NodeType::ContinueStatement:
+                CompileContinueStatement();
+                break;
+            case SyntaxTree::NodeType::IfStatement:
+                CompileIfStatement(node);
+                break;
+            case SyntaxTree::NodeType::ReturnStatement:
+                CompileReturnStatement(node);
+                break;
+            case SyntaxTree::NodeType::CallStatement:
+            {
+                auto reg = AllocRegisters();
+                CompileCall(node, reg, 0);
+                FreeRegisters(reg);
+                break;
+            }
+            default:
+            {
+                auto reg = AllocRegisters();
+                CompileMultiOrSingle(node, reg);
+                FreeRegisters(reg);
+                break;
+            }
+            }
+        }
+
+        void CompileVarNameListStatement(const SyntaxTree::NodePtr& node)
+        {
+            auto statement = static_cast<SyntaxTree::VarNameListStatement*>(node);
+            auto& names = static_cast<SyntaxTree::NameList*>(statement->name_list)->names;
+            auto base = _fs->free_reg;
+            if (statement->expr_list)
+            {
+                CompileExpressionList(statement->expr_list, base, names.size());
+            }
+            else
+            {
+                (void)AllocRegisters(names.size());
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::LoadNil, base, names.size()));
+            }
+            SizeT kept = 0;
+            for (SizeT i = 0; i < names.size(); ++i)
+            {
+                if (DeclareVariable(names[i]->StringValue(), base + i))
+                {
+                    kept = i + 1;
+                }
+            }
+            FreeRegisters(base + kept);
+        }
+
+        void CompileAssignmentStatement(const SyntaxTree::NodePtr& node)
+        {
+            auto statement = static_cast<SyntaxTree::AssignmentStatement*>(node);
+            auto& vars = static_cast<SyntaxTree::VarList*>(statement->var_list)->vars;
+            if (CompileUpdateInPlace(statement) || CompileCompoundMember(statement))
+            {
+                return;
+            }
+            auto base = _fs->free_reg;
+            // left values : (key, container) register pairs, or a plain name
+            TVector<Option<SizeT>> container_regs;
+            TVector<SizeT> keys;
+            for (auto iter = vars.begin(); iter != vars.end(); ++iter)
+            {
+                Assert((*iter)->node_type == SyntaxTree::NodeType::VarExpression);
+                auto var = static_cast<SyntaxTree::VarExpression*>(*iter);
+                if (!var->expr)
+                {
+                    Assert(var->key->node_type == SyntaxTree::NodeType::Terminator);
+                    container_regs.push_back(Option<SizeT>());
+                    keys.push_back(0);
+                    continue;
+                }
+                auto key_reg = AllocRegisters();
+                CompileExpr(var->key, key_reg);
+                auto container_reg = AllocRegisters();
+                CompileExpr(var->expr, container_reg);
+                container_regs.push_back(container_reg);
+                keys.push_back(key_reg);
+            }
+            // right values
+            auto values_base = _fs->free_reg;
+            CompileExpressionList(statement->expr_list, values_base, vars.size());
+            for (SizeT i = 0; i < vars.size(); ++i)
+            {
+                if (container_regs[i])
+                {
+                    Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::SetMember, *container_regs[i], keys[i], values_base + i));
+                }
+                else
+                {
+                    auto key = static_cast<SyntaxTree::VarExpression*>(vars[i])->key;
+                    CompileStoreName(vars[i], static_cast<SyntaxTree::Terminator*>(key)->token->StringValue(), values_base + i);
+                }
+            }
+            FreeRegisters(base);
+        }
+
+        // a = a op b on a local register writes the result straight back to the register,
+        // which lets the executor grow a string that nothing else holds instead of copying it
+        bool CompileUpdateInPlace(const SyntaxTree::AssignmentStatement* statement)
+        {
+            auto& vars = static_cast<SyntaxTree::VarList*>(statement->var_list)->vars;
+            auto& exprs = static_cast<SyntaxTree::ExpressionList*>(statement->expr_list)->exprs;
+            if (
+                vars.size() != 1
+                || exprs.size() != 1
+                || static_cast<SyntaxTree::VarExpression*>(vars[0])->expr
+                || exprs[0]->node_type != SyntaxTree::NodeType::BinaryExpression
+            )
+            {
+                return false;
+            }
+            auto variable = _resolver.Reference(vars[0]);
+            if (!variable || _locations[*variable].captured)
+            {
+                return false;
+            }
+            auto expr = static_cast<SyntaxTree::BinaryExpression*>(exprs[0]);
+            auto left = LocalRegister(expr->left);
+            // the right side must not assign the variable before the operator reads it
+            if (!left || *left != _locations[*variable].index || RunsStatements(expr->right))
+            {
+                return false;
+            }
+            CompileExpr(expr, *left);
+            return true;
+        }
+
+        // a[k] op= b evaluates a and k once, the current value is read through their registers
+        bool CompileCompoundMember(const SyntaxTree::AssignmentStatement* statement)
+        {
+            if (!statement->compound)
+            {
+                return false;
+            }
+            auto var = static_cast<SyntaxTree::VarExpression*>(static_cast<SyntaxTree::VarList*>(statement->var_list)->vars[0]);
+            auto expr = static_cast<SyntaxTree::ExpressionList*>(statement->expr_list)->exprs[0];
+            if (!var->expr || expr->node_type != SyntaxTree::NodeType::BinaryExpression)
+            {
+                return false;
+            }
+            auto binary_expr = static_cast<SyntaxTree::BinaryExpression*>(expr);
+            if (binary_expr->left->node_type != SyntaxTree::NodeType::BinaryExpression)
+            {
+                return false;
+            }
+            auto base = _fs->free_reg;
+            auto key_reg = AllocRegisters();
+            CompileExpr(var->key, key_reg);
+            auto container_reg = AllocRegisters();
+            CompileExpr(var->expr, container_reg);
+            auto value_reg = AllocRegisters();
+            EmitBinary(binary_expr->left, Bytecode::OpCode::GetMember, container_reg, key_reg, value_reg);
+            auto temp_reg = AllocRegisters();
+            auto right_reg = CompileToAnyReg(binary_expr->right, temp_reg);
+            EmitBinary(binary_expr, BinaryOpCode(binary_expr->op->GetType()), value_reg, right_reg, value_reg);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::SetMember, container_reg, key_reg, value_reg));
+            FreeRegisters(base);
+            return true;
+        }
+
+        void CompileWhileStatement(const SyntaxTree::NodePtr& node)
+        {
+            auto statement = static_cast<SyntaxTree::WhileStatement*>(node);
+            auto loop_start = _fs->proto->code.size();
+            auto reg = AllocRegisters();
+            auto exit_jump = EmitJump(Bytecode::OpCode::JmpIfNot, CompileToAnyReg(statement->expr, reg));
+            FreeRegisters(reg);
+
+            _fs->loops.push_back(LoopState());
+            _fs->loops.back().scope_depth = _fs->scope_depth;
+            CompileScopedBlock(statement->block);
+            PatchJump(EmitJump(Bytecode::OpCode::Jmp), loop_start);
+            for (auto iter = _fs->loops.back().continue_jumps.begin(); iter != _fs->loops.back().continue_jumps.end(); ++iter)
+            {
+                PatchJump(*iter, loop_start);
+            }
+
+            PatchJumpHere(exit_jump);
+            for (auto iter = _fs->loops.back().break_jumps.begin(); iter != _fs->loops.back().break_jumps.end(); ++iter)
+            {
+                PatchJumpHere(*iter);
+            }
+            _fs->loops.pop_back();
+        }
+
+        void CompileForStatement(const SyntaxTree::NodePtr& node)
+        {
+            auto statement = static_cast<SyntaxTree::ForStatement*>(node);
+            auto& names = static_cast<SyntaxTree::NameList*>(statement->var_name_list)->names;
+            auto scope = EnterScope(node);
+            // define params, the first two take the items of the iteration
+            auto base = AllocRegisters(names.size() > 2 ? names.size() + 2 : 4);
+            TVector<SizeT> name_regs;
+            for (SizeT i = 0; i < names.size(); ++i)
+            {
+                name_regs.push_back(base + 2 + i);
+            }
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::LoadNil, base + 2, names.size()));
+            for (SizeT i = 0; i < names.size(); ++i)
+            {
+                (void)DeclareVariable(names[i]->StringValue(), name_regs[i]);
+            }
+            CompileExpr(statement->expr, base);
+            auto prep_jump = EmitJump(Bytecode::OpCode::ForPrep, base);
+
+            auto body_start = _fs->proto->code.size();
+            for (SizeT i = 0; i < names.size() && i < 2; ++i)
+            {
+                auto& location = _locations[_resolver.FindVariable(_scope, names[i]->StringValue())];
+                if (location.captured)
+                {
+                    Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::SetUpval, name_regs[i], _heap_level - location.heap_level, location.index));
+                }
+            }
+            _fs->loops.push_back(LoopState());
+            _fs->loops.back().scope_depth = _fs->scope_depth;
+            CompileScopedBlock(statement->block);
+
+            PatchJumpHere(prep_jump);
+            for (auto iter = _fs->loops.back().continue_jumps.begin(); iter != _fs->loops.back().continue_jumps.end(); ++iter)
+            {
+                PatchJumpHere(*iter);
+            }
+            PatchJump(EmitJump(Bytecode::OpCode::ForLoop, base), body_start);
+            for (auto iter = _fs->loops.back().break_jumps.begin(); iter != _fs->loops.back().break_jumps.end(); ++iter)
+            {
+                PatchJumpHere(*iter);
+            }
+            _fs->loops.pop_back();
+            LeaveScope(scope);
+        }
+
+        void CompileBreakStatement()
+        {
+            if (_fs->loops.empty())
+            {
+                Error(U"Unexcept 'break'");
+            }
+            auto& loop = _fs->loops.back();
+            if (_fs->scope_depth > loop.scope_depth)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::PopScope, _fs->scope_depth - loop.scope_depth));
+            }
+            loop.break_jumps.push_back(EmitJump(Bytecode::OpCode::Jmp));
+        }
+
+        void CompileContinueStatement()
+        {
+            if (_fs->loops.empty())
+            {
+                Error(U"Unexcept 'continue'");
+            }
+            auto& loop = _fs->loops.back();
+            if (_fs->scope_depth > loop.scope_depth)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::PopScope, _fs->scope_depth - loop.scope_depth));
+            }
+            loop.continue_jumps.push_back(EmitJump(Bytecode::OpCode::Jmp));
+        }
+
+        void CompileReturnStatement(const SyntaxTree::NodePtr& node)
+        {
+            auto statement = static_cast<SyntaxTree::ReturnStatement*>(node);
+            if (_fs->return_targets.empty())
+            {
+                auto base = _fs->free_reg;
+                CompileExpressionList(statement->exprs, base, OpenResults);
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Return, base, 0));
+                FreeRegisters(base);
+                return;
+            }
+            // 'return' inside an if branch gives the values of the if expression
+            auto& target = _fs->return_targets.back();
+            auto saved_free_reg = _fs->free_reg;
+            if (saved_free_reg == target.reg + 1)
+            {
+                FreeRegisters(target.reg);
+                CompileExpressionList(statement->exprs, target.reg, OpenResults);
+            }
+            else
+            {
+                // locals of the branch are above the target, and the values may read them
+                CompileExpressionList(statement->exprs, saved_free_reg, OpenResults);
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::MoveList, target.reg, saved_free_reg));
+            }
+            _fs->free_reg = saved_free_reg;
+            if (_fs->scope_depth > target.scope_depth)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::PopScope, _fs->scope_depth - target.scope_depth));
+            }
+            target.jumps.push_back(EmitJump(Bytecode::OpCode::Jmp));
+        }
+
+        // an if statement has no value, 'return' in it leaves the function or the enclosing if expression
+        void CompileIfStatement(const SyntaxTree::NodePtr& node)
+        {
+            auto statement = static_cast<SyntaxTree::IfStatement*>(node);
+            auto reg = AllocRegisters();
+            auto false_jump = EmitJump(Bytecode::OpCode::JmpIfNot, CompileToAnyReg(statement->expr, reg));
+            FreeRegisters(reg);
+            CompileScopedBlock(statement->true_branch);
+            if (!statement->false_branch)
+            {
+                PatchJumpHere(false_jump);
+                return;
+            }
+            auto end_jump = EmitJump(Bytecode::OpCode::Jmp);
+            PatchJumpHere(false_jump);
+            if (statement->false_branch->node_type == SyntaxTree::NodeType::IfStatement)
+            {
+                CompileIfStatement(statement->false_branch);
+            }
+            else
+            {
+                Assert(statement->false_branch->node_type == SyntaxTree::NodeType::ElseStatement);
+                CompileScopedBlock(static_cast<SyntaxTree::ElseStatement*>(statement->false_branch)->block);
+            }
+            PatchJumpHere(end_jump);
+        }
+
+        // an if expression leaves one or more values from reg, and sets top
+        void CompileIf(const SyntaxTree::NodePtr& node, SizeT reg)
+        {
+            Assert(reg + 1 == _fs->free_reg);
+            auto statement = static_cast<SyntaxTree::IfStatement*>(node);
+            CompileExpr(statement->expr, reg);
+            auto false_jump = EmitJump(Bytecode::OpCode::JmpIfNot, reg);
+            CompileBranch(statement->true_branch, reg);
+            auto end_jump = EmitJump(Bytecode::OpCode::Jmp);
+            PatchJumpHere(false_jump);
+            if (!statement->false_branch)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::LoadNil, reg, 1));
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::SetTop, reg + 1));
+            }
+            else if (statement->false_branch->node_type == SyntaxTree::NodeType::IfStatement)
+            {
+                CompileIf(statement->false_branch, reg);
+            }
+            else
+            {
+                Assert(statement->false_branch->node_type == SyntaxTree::NodeType::ElseStatement);
+                auto else_statement = static_cast<SyntaxTree::ElseStatement*>(statement->false_branch);
+                CompileBranch(else_statement->block, reg);
+            }
+            PatchJumpHere(end_jump);
+        }
+
+        void CompileBranch(const SyntaxTree::NodePtr& node, SizeT reg)
+        {
+            _fs->return_targets.push_back(ReturnTarget());
+            _fs->return_targets.back().reg = reg;
+            _fs->return_targets.back().scope_depth = _fs->scope_depth;
+            CompileScopedBlock(node);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::LoadNil, reg, 1));
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::SetTop, reg + 1));
+            for (auto iter = _fs->return_targets.back().jumps.begin(); iter != _fs->return_targets.back().jumps.end(); ++iter)
+            {
+                PatchJumpHere(*iter);
+            }
+            _fs->return_targets.pop_back();
+        }
+
+        void CompileFunction(const SyntaxTree::NodePtr& node, SizeT reg)
+        {
+            auto statement = static_cast<SyntaxTree::FunctionStatement*>(node);
+            auto& names = static_cast<SyntaxTree::NameList*>(statement->var_name_list)->names;
+            FunctionState fs(statement->name ? statement->name->StringValue() : U"<anonymous>", _module_name, _fs);
+            _fs = &fs;
+            auto scope = EnterScope(node);
+            // define params
+            fs.proto->param_count = names.size();
+            (void)AllocRegisters(names.size());
+            for (SizeT i = 0; i < names.size(); ++i)
+            {
+                (void)DeclareVariable(names[i]->StringValue(), i);
+            }
+            // run func
+            CompileBlockStatements(statement->block);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Return, 0, 1));
+            LeaveFunctionScope(scope);
+            _fs = fs.parent;
+
+            _fs->proto->protos.push_back(fs.proto);
+            Emit(Bytecode::Instruction::ABx(Bytecode::OpCode::Closure, reg, _fs->proto->protos.size() - 1));
+            if (statement->name)
+            {
+                Assert(statement->name->GetType() == ETokenType::Id);
+                Emit(Bytecode::Instruction::ABx(Bytecode::OpCode::SetGlobal, reg, NameConstant(statement->name->StringValue())));
+            }
+        }
+
+        // func at reg, params after it, results from reg
+        void CompileCall(const SyntaxTree::NodePtr& node, SizeT reg, SizeT result_count)
+        {
+            Assert(reg + 1 == _fs->free_reg);
+            auto statement = static_cast<SyntaxTree::CallStatement*>(node);
+            CompileExpr(statement->func, reg);
+            auto& exprs = static_cast<SyntaxTree::ExpressionList*>(statement->expr_list)->exprs;
+            SizeT b = 1;
+            if (!exprs.empty())
+            {
+                CompileExpressionList(statement->expr_list, _fs->free_reg, OpenResults);
+                b = 0;
+            }
+            FreeRegisters(reg + 1);
+            if (result_count == OpenResults)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Call, reg, b, 0));
+            }
+            else
+            {
+                ReserveStack(reg + result_count);
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Call, reg, b, result_count + 1));
+            }
+        }
+
+        void CompileArray(const SyntaxTree::NodePtr& node, SizeT reg)
+        {
+            Assert(reg + 1 == _fs->free_reg);
+            auto statement = static_cast<SyntaxTree::ArrayStatement*>(node);
+            if (!statement->expr_list)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::NewArray, reg, 1));
+                return;
+            }
+            CompileExpressionList(statement->expr_list, _fs->free_reg, OpenResults);
+            FreeRegisters(reg + 1);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::NewArray, reg, 0));
+        }
+
+        void CompileMap(const SyntaxTree::NodePtr& node, SizeT reg)
+        {
+            Assert(reg + 1 == _fs->free_reg);
+            auto statement = static_cast<SyntaxTree::MapStatement*>(node);
+            auto& keys = static_cast<SyntaxTree::ExpressionList*>(statement->key_expr_list)->exprs;
+            auto& vals = static_cast<SyntaxTree::ExpressionList*>(statement->val_expr_list)->exprs;
+            Assert(keys.size() == vals.size());
+            auto base = AllocRegisters(keys.size() * 2);
+            for (SizeT i = 0; i < keys.size(); ++i)
+            {
+                CompileExpr(keys[i], base + i);
+            }
+            for (SizeT i = 0; i < vals.size(); ++i)
+            {
+                CompileExpr(vals[i], base + keys.size() + i);
+            }
+            FreeRegisters(reg + 1);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::NewDict, reg, keys.size()));
+        }
+
+        // exactly `want` values from base, or one or more values with top set if want is OpenResults
+        void CompileExpressionList(const SyntaxTree::NodePtr& node, SizeT base, SizeT want)
+        {
+            Assert(base == _fs->free_reg);
+            auto& exprs = static_cast<SyntaxTree::ExpressionList*>(node)->exprs;
+            Assert(!exprs.empty());
+            for (SizeT i = 0; i < exprs.size(); ++i)
+            {
+                auto reg = AllocRegisters();
+                if (i + 1 < exprs.size())
+                {
+                    CompileExpr(exprs[i], reg);
+                }
+                else if (want == OpenResults)
+                {
+                    CompileMultiOrSingle(exprs[i], reg);
+                    if (!IsMultiExpr(exprs[i]))
+                    {
+                        Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::SetTop, reg + 1));
+                    }
+                }
+                else if (i < want)
+                {
+                    auto rest = want - i;
+                    if (exprs[i]->node_type == SyntaxTree::NodeType::CallStatement)
+                    {
+                        CompileCall(exprs[i], reg, rest);
+                    }
+                    else if (exprs[i]->node_type == SyntaxTree::NodeType::IfStatement)
+                    {
+                        CompileIf(exprs[i], reg);
+                        if (rest > 1)
+                        {
+                            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Adjust, reg, rest));
+                        }
+                    }
+                    else
+                    {
+                        CompileExpr(exprs[i], reg);
+                        if (rest > 1)
+                        {
+                            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::LoadNil, reg + 1, rest - 1));
+                        }
+                    }
+                    (void)AllocRegisters(rest - 1);
+                }
+                else
+                {
+                    CompileExpr(exprs[i], reg);
+                }
+            }
+        }
+
+        bool IsMultiExpr(const SyntaxTree::NodePtr& node) const
+        {
+            return node->node_type == SyntaxTree::NodeType::CallStatement
+                || node->node_type == SyntaxTree::NodeType::IfStatement;
+        }
+
+        // calls and if expressions leave all their values with top set, others leave one value
+        void CompileMultiOrSingle(const SyntaxTree::NodePtr& node, SizeT reg)
+        {
+            Assert(reg + 1 == _fs->free_reg);
+            if (node->node_type == SyntaxTree::NodeType::CallStatement)
+            {
+                CompileCall(node, reg, OpenResults);
+            }
+            else if (node->node_type == SyntaxTree::NodeType::IfStatement)
+            {
+                CompileIf(node, reg);
+            }
+            else
+            {
+                CompileExpr(node, reg);
+            }
+        }
+
+        // exactly one value at reg
+        void CompileExpr(const SyntaxTree::NodePtr& node, SizeT reg)
+        {
+            switch (node->node_type)
+            {
+            case SyntaxTree::NodeType::Terminator:
+            {
+                auto terminator = static_cast<SyntaxTree::Terminator*>(node);
+                if (terminator->token->GetType() == ETokenType::Id)
+                {
+                    CompileLoadName(node, terminator->token->StringValue(), reg);
+                }
+                else
+                {
+                    Emit(Bytecode::Instruction::ABx(Bytecode::OpCode::LoadK, reg, Constant(Value::New(terminator->token))));
+                }
+                break;
+            }
+            case SyntaxTree::NodeType::BinaryExpression:
+            {
+                auto expr = static_cast<SyntaxTree::BinaryExpression*>(node);
+                auto op = BinaryOpCode(expr->op->GetType());
+                if (_resolver.Reference(node))
+                {
+                    CompileOperatorCall(node, op, { expr->left, expr->right }, reg);
+                    break;
+                }
+                auto left_reg = reg;
+                if (!LocalRegister(expr->left) || RunsStatements(expr->right))
+                {
+                    CompileExpr(expr->left, reg);
+                }
+                else
+                {
+                    left_reg = *LocalRegister(expr->left);
+                }
+                auto temp_reg = AllocRegisters();
+                auto right_reg = CompileToAnyReg(expr->right, temp_reg);
+                Emit(Bytecode::Instruction::ABC(op, reg, left_reg, right_reg));
+                FreeRegisters(temp_reg);
+                break;
+            }
+            case SyntaxTree::NodeType::UnaryExpression:
+            {
+                auto expr = static_cast<SyntaxTree::UnaryExpression*>(node);
+                auto op = UnaryOpCode(expr->op->GetType());
+                if (_resolver.Reference(node))
+                {
+                    CompileOperatorCall(node, op, { expr->expr }, reg);
+                    break;
+                }
+                Emit(Bytecode::Instruction::ABC(op, reg, CompileToAnyReg(expr->expr, reg)));
+                break;
+            }
+            case SyntaxTree::NodeType::ConditionalExpression:
+            {
+                // only the branch that is taken is evaluated
+                auto expr = static_cast<SyntaxTree::ConditionalExpression*>(node);
+                auto false_jump = EmitJump(Bytecode::OpCode::JmpIfNot, CompileToAnyReg(expr->expr, reg));
+                CompileExpr(expr->true_expr, reg);
+                auto end_jump = EmitJump(Bytecode::OpCode::Jmp);
+                PatchJumpHere(false_jump);
+                CompileExpr(expr->false_expr, reg);
+                PatchJumpHere(end_jump);
+                break;
+            }
+            case SyntaxTree::NodeType::FunctionStatement:
+                CompileFunction(node, reg);
+                break;
+            case SyntaxTree::NodeType::CallStatement:
+            case SyntaxTree::NodeType::IfStatement:
+            case SyntaxTree::NodeType::ArrayStatement:
+            case SyntaxTree::NodeType::MapStatement:
+            {
+                // these need free registers after the result
+                auto temp_reg = reg;
+                if (reg + 1 != _fs->free_reg)
+                {
+                    temp_reg = AllocRegisters();
+                }
+                if (node->node_type == SyntaxTree::NodeType::CallStatement)
+                {
+                    CompileCall(node, temp_reg, 1);
+                }
+                else if (node->node_type == SyntaxTree::NodeType::IfStatement)
+                {
+                    CompileIf(node, temp_reg);
+                }
+                else if (node->node_type == SyntaxTree::NodeType::ArrayStatement)
+                {
+                    CompileArray(node, temp_reg);
+                }
+                else
+                {
+                    CompileMap(node, temp_reg);
+                }
+                if (temp_reg != reg)
+                {
+                    Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Move, reg, temp_reg));
+                    FreeRegisters(temp_reg);
+                }
+                break;
+            }
+            default:
+                Error(U"Unexcept syntax tree node");
+                break;
+            }
+        }
+
+        // an operator function declared as a variable is called like any other function
+        void CompileOperatorCall(const SyntaxTree::NodePtr& node, Bytecode::OpCode op, const SyntaxTree::NodePtrList& operands, SizeT reg)
+        {
+            auto func_reg = AllocRegisters();
+            CompileLoadName(node, Bytecode::OperatorFunctionName(op).StringValue(), func_reg);
+            for (auto iter = operands.begin(); iter != operands.end(); ++iter)
+            {
+                CompileExpr(*iter, AllocRegisters());
+            }
+            FreeRegisters(func_reg + 1);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Call, func_reg, operands.size() + 1, 2));
+            if (func_reg != reg)
+            {
+                Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Move, reg, func_reg));
+            }
+            FreeRegisters(func_reg);
+        }
+
+        // R(reg) = R(left_reg) op R(right_reg), through the operator function if node sees a local one
+        void EmitBinary(const SyntaxTree::NodePtr& node, Bytecode::OpCode op, SizeT left_reg, SizeT right_reg, SizeT reg)
+        {
+            if (!_resolver.Reference(node))
+            {
+                Emit(Bytecode::Instruction::ABC(op, reg, left_reg, right_reg));
+                return;
+            }
+            auto func_reg = AllocRegisters();
+            CompileLoadName(node, Bytecode::OperatorFunctionName(op).StringValue(), func_reg);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Move, AllocRegisters(), left_reg));
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Move, AllocRegisters(), right_reg));
+            FreeRegisters(func_reg + 1);
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Call, func_reg, 3, 2));
+            Emit(Bytecode::Instruction::ABC(Bytecode::OpCode::Move, reg, func_reg));
+            FreeRegisters(func_reg);
+        }
+
+        Bytecode::OpCode BinaryOpCode(ETokenType t) const
+        {
+            auto op = Bytecode::BinaryOpCode(t);
+            if (!op)
+            {
+                Error(U"Invalid binary operator");
+            }
+            return *op;
+        }
+
+        Bytecode::OpCode UnaryOpCode(ETokenType t) const
+        {
+            auto op = Bytecode::UnaryOpCode(t);
+            if (!op)
+            {
+                Error(U"Invalid unary operator");
+            }
+            return *op;
+        }
+
+    private:
+        StringT _module_name;
+        FunctionState* _fs = nullptr;
+        Resolver _resolver;
+        TVector<Location> _locations;
+        const SyntaxTree::NodeBase* _scope = nullptr;
+        // heap scopes around the code being compiled, counted across functions
+        SizeT _heap_level = 0;
+    };
+}
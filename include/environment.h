@@ -1,8 +1,13 @@
 #pragma once
+#include "bytecode_cache.h"
+#include "compiler.h"
 #include "environment_interface.h"
 #include "executor.h"
 #include "lib_base.h"
 #include "lib_math.h"
+#include "lib_string.h"
+#include "lib_typed_array.h"
+#include "optimizer.h"
 #include "parser.h"
 #include "pre_define.h"
 
@@ -22,7 +27,10 @@ namespace LANG_NS
         {
             BaseLib::Registe(*this);
             MathLib::Registe(*this);
-            _global[U"__loaded"] = Value::New(Value::DictT());
+            StringLib::Registe(*this);
+            TypedArrayLib::Registe(*this);
+            _global[Value::Data::Intern(U"__loaded")] = Value::New(Value::DictT());
+            _operators_overridden = false;
         }
 
         ValuePtr LoadString(const StringT& str) override
@@ -33,9 +41,9 @@ namespace LANG_NS
             try
             {
                 auto ast = parser->Parse();
-                auto values = MakeShared<Executor::Node>(ast, nullptr)->Execute(*this);
-                Assert(!values.empty());
-                return values[0];
+                Optimizer(scanner->GetArena(), !OperatorsOverridden()).Optimize(ast);
+                auto proto = Compiler(parser->ModuleName()).Compile(ast);
+                return Executor::MakeFunction(proto, nullptr);
             }
             catch (const Exception & e)
             {
@@ -44,17 +52,33 @@ namespace LANG_NS
             return nullptr;
         }
 
+        // a valid module.snoc next to the source skips scanning, parsing and compiling
         ValuePtr LoadFile(const StringT& file_name) override
         {
-            auto reader = MakeShared<Unicode::FileReader>(file_name);
-            auto scanner = MakeShared<Scanner>(reader);
-            auto parser = MakeShared<Parser>(scanner);
+            auto fold_operators = !OperatorsOverridden();
+            auto key = Bytecode::Cache::SourceKey(file_name, fold_operators);
+            if (key)
+            {
+                auto proto = Bytecode::Cache::Load(file_name, *key);
+                if (proto)
+                {
+                    return Executor::MakeFunction(proto, nullptr);
+                }
+            }
             try
             {
+                // the reader decodes non utf-8 files up front, so malformed input already throws here
+                auto reader = MakeShared<Unicode::FileReader>(file_name);
+                auto scanner = MakeShared<Scanner>(reader);
+                auto parser = MakeShared<Parser>(scanner);
                 auto ast = parser->Parse();
-                auto values = MakeShared<Executor::Node>(ast, nullptr)->Execute(*this);
-                Assert(!values.empty());
-                return values[0];
+                Optimizer(scanner->GetArena(), fold_operators).Optimize(ast);
+                auto proto = Compiler(parser->ModuleName()).Compile(ast);
+                if (key)
+                {
+                    Bytecode::Cache::Save(file_name, *key, proto);
+                }
+                return Executor::MakeFunction(proto, nullptr);
             }
             catch (const Exception & e)
             {
@@ -68,7 +92,8 @@ namespace LANG_NS
         {
             for (auto iter = functions.begin(); iter != functions.end(); ++ iter)
             {
-                _global[iter->first] = Value::New(iter->second);
+                _global[Value::Data::Intern(iter->first)] = Value::New(iter->second);
+                CheckOperatorOverride(iter->first);
             }
         }
 
@@ -84,8 +109,10 @@ namespace LANG_NS
 
         ValuePtr AssignValue(const ValueData& k, ValuePtr v) override
         {
-            _global[k] = v;
-            return _global[k];
+            CheckOperatorOverride(k);
+            auto& slot = _global[k];
+            slot = std::move(v);
+            return slot;
         }
 
         ValuePtrList Call(ValuePtr func, const ValuePtrList& params) override
@@ -108,7 +135,32 @@ namespace LANG_NS
             return {};
         }
 
+        bool OperatorsOverridden() const override
+        {
+            return _operators_overridden;
+        }
+
+    private:
+        // operator functions are named __xxx
+        void CheckOperatorOverride(const StringT& name)
+        {
+            if (name.size() > 2 && name[0] == U'_' && name[1] == U'_')
+            {
+                _operators_overridden = true;
+            }
+        }
+
+        // reads the name in place, a narrow name is not widened on every global assignment
+        void CheckOperatorOverride(const ValueData& k)
+        {
+            if (k.GetType() == Value::EType::String && k.StringSize() > 2 && k.StringAt(0) == U'_' && k.StringAt(1) == U'_')
+            {
+                _operators_overridden = true;
+            }
+        }
+
     private:
-        TMap<ValueData, ValuePtr> _global;
+        Value::DictT _global;
+        bool _operators_overridden = false;
     };
 }
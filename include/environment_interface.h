@@ -13,5 +13,7 @@ namespace LANG_NS
         virtual ValuePtr GetValue(const ValueData& k) = 0;
         virtual ValuePtr AssignValue(const ValueData& k, ValuePtr v) = 0;
         virtual ValuePtrList Call(ValuePtr func, const ValuePtrList& params) = 0;
+        // true once a builtin operator function such as __add was replaced
+        virtual bool OperatorsOverridden() const = 0;
     };
 }
\ No newline at end of file
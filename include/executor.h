@@ -1,506 +1,795 @@
 #pragma once
+#include <iterator>
 #include <memory>
+#include "bytecode.h"
 #include "environment_interface.h"
+#include "iterator.h"
+#include "operator.h"
 #include "pre_define.h"
-#include "syntax_tree.h"
+#include "typed_array.h"
 
 namespace LANG_NS
 {
 	namespace Executor
 	{
-        class ControlException : public std::exception
+        // slots of the captured variables of a scope, other variables live in registers
+        class Scope
         {
         public:
-            enum class EType
+            Scope(const SharedPtr<Scope>& parent, SizeT size)
+                : _slots(size)
+                , _parent(parent)
+            {}
+
+            const SharedPtr<Scope>& GetParent() const
             {
-                Return = 0,
-                Break,
-                Continute,
-            };
+                return _parent;
+            }
 
-            ControlException(EType t, ValuePtrList v = ValuePtrList())
-                : ce_type(t)
-                , ce_values(v)
+            // slot index of the scope depth levels up, a slot is null until it is assigned
+            ValuePtr& Slot(SizeT depth, SizeT index)
             {
+                Scope* scope = this;
+                for (SizeT i = 0; i < depth; ++i)
+                {
+                    scope = scope->_parent.get();
+                }
+                Assert(index < scope->_slots.size());
+                return scope->_slots[index];
             }
 
-        public:
-            EType ce_type;
-            ValuePtrList ce_values;
+            void Reset(const SharedPtr<Scope>& parent, SizeT size)
+            {
+                _slots.clear();
+                _slots.resize(size);
+                _parent = parent;
+            }
+
+        private:
+            TVector<ValuePtr> _slots;
+            SharedPtr<Scope> _parent;
         };
 
-        class Node;
-        static ValuePtr GetValueFromList(const ValuePtrList& values, SizeT index = 0);
-        static ValuePtrList ChunkCall(SharedPtr<Node> block, EnvironmentInterface& env, const ValuePtrList& params);
-        static ValuePtrList FunctionCall(SharedPtr<Node> block, EnvironmentInterface& env, const ValuePtrList& params, const ValuePtrList& param_names);
+        // scopes that no closure captured are kept here for reuse
+        class ScopePool : NoCopyable
+        {
+        public:
+            static ScopePool& GetInstance()
+            {
+                static ScopePool _instance;
+                return _instance;
+            }
 
-        class Node
+            SharedPtr<Scope> New(const SharedPtr<Scope>& parent, SizeT size)
+            {
+                if (_free_scopes.empty())
+                {
+                    return MakeShared<Scope>(parent, size);
+                }
+                auto scope = std::move(_free_scopes.back());
+                _free_scopes.pop_back();
+                scope->Reset(parent, size);
+                return scope;
+            }
+
+            // returns the parent of scope
+            SharedPtr<Scope> Release(SharedPtr<Scope>& scope)
+            {
+                auto parent = scope->GetParent();
+                if (scope.use_count() == 1 && _free_scopes.size() < MaxFreeScopes)
+                {
+                    scope->Reset(nullptr, 0);
+                    _free_scopes.push_back(std::move(scope));
+                }
+                scope.reset();
+                return parent;
+            }
+
+        private:
+            ScopePool() = default;
+
+            static const SizeT MaxFreeScopes = 256;
+            TVector<SharedPtr<Scope>> _free_scopes;
+        };
+
+        // registers of all active frames, each frame owns a window of it
+        class Stack : NoCopyable
         {
         public:
-            Node(const SyntaxTree::NodePtr& syntax_tree_node, Node* parent)
-                : _syntax_tree_node(syntax_tree_node)
-                , _parent(parent)
-            {}
+            static Stack& GetInstance()
+            {
+                static Stack _instance;
+                return _instance;
+            }
 
-            const SyntaxTree::NodePtr GetSyntaxTreeNode() const
+            TVector<ValuePtr>& Values()
             {
-                return _syntax_tree_node;
+                return _values;
             }
 
-            ValuePtr GetValue(const ValueData& k, EnvironmentInterface& env)
+            SizeT Push(SizeT size)
             {
-                auto iter = _node_env.find(k);
-                if (iter != _node_env.end())
+                auto base = _top;
+                Grow(base + size);
+                return base;
+            }
+
+            // releases the values of the frame at base and above
+            void Pop(SizeT base)
+            {
+                Assert(base <= _top);
+                for (SizeT i = base; i < _top; ++i)
                 {
-                    return iter->second;
+                    _values[i].reset();
                 }
-                if (_parent)
+                _top = base;
+            }
+
+            // only the newest frame may grow
+            void Grow(SizeT top)
+            {
+                if (top > _values.size())
                 {
-                    return _parent->GetValue(k, env);
+                    _values.resize(top > _values.size() * 2 ? top : _values.size() * 2);
+                }
+                if (top > _top)
+                {
+                    _top = top;
                 }
-                return env.GetValue(k);
             }
 
-            void SetValue(const ValueData& k, ValuePtr v, EnvironmentInterface& env)
+        private:
+            Stack() = default;
+
+            TVector<ValuePtr> _values;
+            SizeT _top = 0;
+        };
+
+        // param and result lists of calls, kept with their capacity so a call does not allocate them
+        class ValueListPool : NoCopyable
+        {
+        public:
+            static ValueListPool& GetInstance()
             {
-                _node_env[k] = v;
+                static ValueListPool _instance;
+                return _instance;
             }
 
-            ValuePtr AssignValue(const ValueData& k, ValuePtr v, EnvironmentInterface& env)
+            ValuePtrList New()
             {
-                if (_node_env.find(k) != _node_env.end())
+                if (_free_lists.empty())
                 {
-                    _node_env[k] = v;
-                    return _node_env[k];
+                    return ValuePtrList();
                 }
-                if (_parent)
+                auto params = std::move(_free_lists.back());
+                _free_lists.pop_back();
+                return params;
+            }
+
+            void Release(ValuePtrList& params)
+            {
+                params.clear();
+                if (_free_lists.size() < MaxFreeLists)
                 {
-                    return _parent->AssignValue(k, v, env);
+                    _free_lists.push_back(std::move(params));
                 }
-                return env.AssignValue(k, v);
             }
 
-            SharedPtr<Node> MakeChildNode(const SyntaxTree::NodePtr& syntax_tree_node)
+        private:
+            ValueListPool() = default;
+
+            static const SizeT MaxFreeLists = 64;
+            TVector<ValuePtrList> _free_lists;
+        };
+
+        class Frame : NoCopyable
+        {
+        public:
+            Frame(SizeT size)
+                : _stack(Stack::GetInstance())
+                , _base(_stack.Push(size))
+            {}
+
+            ~Frame()
+            {
+                _stack.Pop(_base);
+            }
+
+            SizeT Base() const
+            {
+                return _base;
+            }
+
+        private:
+            Stack& _stack;
+            SizeT _base;
+        };
+
+        static ValuePtrList Execute(const Bytecode::ProtoPtr& proto, const SharedPtr<Scope>& upper_scope, EnvironmentInterface& env, const ValuePtrList& params);
+
+        static ValuePtr MakeFunction(const Bytecode::ProtoPtr& proto, const SharedPtr<Scope>& upper_scope)
+        {
+            return Value::New(
+                std::bind(
+                    &Execute,
+                    proto,
+                    upper_scope,
+                    std::placeholders::_1,
+                    std::placeholders::_2
+                )
+            );
+        }
+
+        static ValuePtr GetValueFromList(const ValuePtrList& values, SizeT index = 0)
+        {
+            if (values.size() <= index)
+            {
+                return Value::New();
+            }
+            return values[index];
+        }
+
+        // like GetValueFromList for a list that is dropped afterwards, the value is moved out
+        static ValuePtr TakeValueFromList(ValuePtrList& values, SizeT index = 0)
+        {
+            if (values.size() <= index)
             {
-                auto child = MakeShared<Node>(syntax_tree_node, this);
-                _children.push_back(child);
-                return child;
+                return Value::New();
             }
+            return std::move(values[index]);
+        }
 
-            ValuePtrList Execute(EnvironmentInterface& env)
+        static void AssignMember(const ValuePtr& container, const ValuePtr& key, const ValuePtr& value, EnvironmentInterface& env)
+        {
+            if (container->GetType() == Value::EType::Nil)
+            {
+                (void)env.AssignValue(*key, value);
+            }
+            else if (container->GetType() == Value::EType::Array)
             {
-                if (!_syntax_tree_node)
+                if (key->GetType() != Value::EType::Int)
                 {
-                    throw(Exception(U"Cannot execute a null syntax tree node!!!"));
-                    return {};
+                    throw(Exception(U"Assign key of array must be a interger"));
                 }
-                switch (_syntax_tree_node->node_type)
-                {
-                case SyntaxTree::NodeType::Chunk:
+                container->SetArrayValue(static_cast<SizeT>(key->IntValue()), value);
+            }
+            else if (container->IsTypedArray())
+            {
+                if (key->GetType() != Value::EType::Int)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::Chunk>(_syntax_tree_node);
-                    return {
-                        Value::New(
-                            std::bind(
-                                &ChunkCall,
-                                MakeShared<Node>(actual_node->block, nullptr),
-                                std::placeholders::_1,
-                                std::placeholders::_2
-                            )
-                        )
-                    };
+                    throw(Exception(U"Assign key of array must be a interger"));
                 }
-                case SyntaxTree::NodeType::Block:
+                container->SetTypedArrayValue(static_cast<SizeT>(key->IntValue()), value);
+            }
+            else if (container->GetType() == Value::EType::Dict)
+            {
+                container->SetDictValue(*key, value);
+            }
+            else
+            {
+                throw(Exception(U"Assign Invalid left value"));
+            }
+        }
+
+        // moves the iteration of R(base) one step, returns false at the end
+        static bool ForNext(TVector<ValuePtr>& values, SizeT base, EnvironmentInterface& env)
+        {
+            if (values[base]->GetType() != Value::EType::Function)
+            {
+                return Iterator::Next(values[base], values[base + 1], values[base + 2], values[base + 3]);
+            }
+            // the stack may grow while the function runs, so no register is held across the call
+            auto results = env.Call(values[base], {});
+            auto first = TakeValueFromList(results, 0);
+            if (!first || first->GetType() == Value::EType::Nil)
+            {
+                return false;
+            }
+            values[base + 2] = std::move(first);
+            values[base + 3] = TakeValueFromList(results, 1);
+            return true;
+        }
+
+        // builtin operators on Int, Float, Bool and String values, false if the operator function has to run
+        static bool FastBinary(Bytecode::OpCode op, const ValuePtr& left, const ValuePtr& right, ValuePtr& result)
+        {
+            using Bytecode::OpCode;
+            auto left_type = left->GetType();
+            auto right_type = right->GetType();
+            switch (op)
+            {
+            case OpCode::And:
+                result = Value::New(left->BoolValue() && right->BoolValue());
+                return true;
+            case OpCode::Or:
+                result = Value::New(left->BoolValue() || right->BoolValue());
+                return true;
+            case OpCode::Equel:
+                result = Value::New(!(*left < *right) && !(*right < *left));
+                return true;
+            case OpCode::NotEquel:
+                result = Value::New((*left < *right) || (*right < *left));
+                return true;
+            case OpCode::GetMember:
+                if (left_type == Value::EType::Array && right_type == Value::EType::Int)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::Block>(_syntax_tree_node);
-                    for (auto iter = actual_node->statements.begin(); iter != actual_node->statements.end(); ++iter)
-                    {
-                        (void)MakeChildNode(*iter)->Execute(env);
-                    }
-                    return {};
-                }
-                case SyntaxTree::NodeType::FunctionStatement:
-                {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::FunctionStatement>(_syntax_tree_node);
-                    auto func = Value::New(
-                        std::bind(
-                            &FunctionCall,
-                            MakeChildNode(actual_node->block),
-                            std::placeholders::_1,
-                            std::placeholders::_2,
-                            MakeChildNode(actual_node->var_name_list)->Execute(env)
-                        )
-                    );
-                    if (actual_node->name)
-                    {
-                        Assert(actual_node->name->GetType() == ETokenType::Id);
-                        (void)env.AssignValue(ValueData(actual_node->name->StringValue()), func);
-                    }
-                    return { func };
+                    auto& array_data = left->ArrayValue();
+                    auto key = static_cast<SizeT>(right->IntValue());
+                    result = key < array_data.size() && array_data[key] ? array_data[key] : Value::New();
+                    return true;
                 }
-                case SyntaxTree::NodeType::ReturnStatement:
+                if (left_type == Value::EType::Dict)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::ReturnStatement>(_syntax_tree_node);
-                    throw(ControlException(ControlException::EType::Return, MakeChildNode(actual_node->exprs)->Execute(env)));
-                    return {};
+                    auto& map_data = left->DictValue();
+                    auto iter = map_data.find(*right);
+                    result = iter == map_data.end() ? Value::New() : iter->second;
+                    return true;
                 }
-                case SyntaxTree::NodeType::CallStatement:
+                if (left->IsTypedArray() && right_type == Value::EType::Int)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::CallStatement>(_syntax_tree_node);
-                    auto func_value = GetValueFromList(MakeChildNode(actual_node->func)->Execute(env));
-                    return env.Call(func_value, MakeChildNode(actual_node->expr_list)->Execute(env));
+                    result = left->TypedArrayAt(static_cast<SizeT>(right->IntValue()));
+                    return true;
                 }
-                case SyntaxTree::NodeType::VarNameListStatement:
+                if (left_type == Value::EType::Range && right_type == Value::EType::Int)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::VarNameListStatement>(_syntax_tree_node);
-                    auto name_val_list = MakeChildNode(actual_node->name_list)->Execute(env);
-                    ValuePtrList expr_val_list;
-                    if (actual_node->expr_list)
-                    {
-                        expr_val_list = MakeChildNode(actual_node->expr_list)->Execute(env);
-                    }
-                    for (SizeT i = 0; i < name_val_list.size(); ++i)
-                    {
-                        _parent->SetValue(*name_val_list[i], GetValueFromList(expr_val_list, i), env);
-                    }
-                    return {};
+                    result = Iterator::RangeAt(left->RangeValue(), static_cast<SizeT>(right->IntValue()));
+                    return true;
                 }
-                case SyntaxTree::NodeType::AssignmentStatement:
+                return false;
+            default:
+                break;
+            }
+            if (left->IsTypedArray() || right->IsTypedArray())
+            {
+                switch (op)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::AssignmentStatement>(_syntax_tree_node);
-                    auto var_key_list = MakeChildNode(actual_node->var_list)->Execute(env);
-                    Assert(var_key_list.size() % 2 == 0);
-                    auto expr_val_list = MakeChildNode(actual_node->expr_list)->Execute(env);
-                    for (SizeT i = 0; i < var_key_list.size(); i += 2)
-                    {
-                        if (var_key_list[i + 1]->GetType() == Value::EType::Nil)
-                        {
-                            (void)AssignValue(*var_key_list[i], GetValueFromList(expr_val_list, i / 2), env);
-                        }
-                        else if (var_key_list[i + 1]->GetType() == Value::EType::Array)
-                        {
-                            if (var_key_list[i]->GetType() != Value::EType::Int)
-                            {
-                                throw(Exception(U"Assign key of array must be a interger"));
-                                return {};
-                            }
-                            auto key = static_cast<SizeT>(var_key_list[i]->IntValue());
-                            var_key_list[i + 1]->SetArrayValue(key, GetValueFromList(expr_val_list, i / 2));
-                        }
-                        else if (var_key_list[i + 1]->GetType() == Value::EType::Dict)
-                        {
-                            auto key = var_key_list[i];
-                            var_key_list[i + 1]->SetDictValue(*key, GetValueFromList(expr_val_list, i / 2));
-                        }
-                        else
-                        {
-                            throw(Exception(U"Assign Invalid left value"));
-                            return {};
-                        }
-                    }
-                    return {};
+                case OpCode::Add:
+                    TypedArray::ElementWise(TypedArray::EOp::Add, left, right, result);
+                    return true;
+                case OpCode::Sub:
+                    TypedArray::ElementWise(TypedArray::EOp::Sub, left, right, result);
+                    return true;
+                case OpCode::Mul:
+                    TypedArray::ElementWise(TypedArray::EOp::Mul, left, right, result);
+                    return true;
+                case OpCode::Div:
+                    TypedArray::ElementWise(TypedArray::EOp::Div, left, right, result);
+                    return true;
+                default:
+                    return false;
                 }
-                case SyntaxTree::NodeType::IfStatement:
+            }
+            if (left_type == Value::EType::Int && right_type == Value::EType::Int)
+            {
+                auto l = left->IntValue();
+                auto r = right->IntValue();
+                switch (op)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::IfStatement>(_syntax_tree_node);
-                    auto expr_value = GetValueFromList(MakeChildNode(actual_node->expr)->Execute(env));
-                    if (!expr_value->BoolValue())
+                case OpCode::BitwiseAnd:
+                    result = Value::New(l & r);
+                    return true;
+                case OpCode::BitwiseOr:
+                    result = Value::New(l | r);
+                    return true;
+                case OpCode::Xor:
+                    result = Value::New(l ^ r);
+                    return true;
+                case OpCode::Add:
+                    result = Value::New(l + r);
+                    return true;
+                case OpCode::Sub:
+                    result = Value::New(l - r);
+                    return true;
+                case OpCode::Mul:
+                    result = Value::New(l * r);
+                    return true;
+                case OpCode::Div:
+                    if (r == 0)
                     {
-                        if (actual_node->false_branch)
-                        {
-                            return MakeChildNode(actual_node->false_branch)->Execute(env);
-                        }
-                        else
-                        {
-                            return {};
-                        }
-
+                        return false;
                     }
-
-                    try
+                    result = Value::New(l / r);
+                    return true;
+                case OpCode::Mod:
+                    if (r == 0)
                     {
-                        (void)MakeChildNode(actual_node->true_branch)->Execute(env);
+                        return false;
                     }
-                    catch (const ControlException & e)
-                    {
-                        if (e.ce_type == ControlException::EType::Return)
-                        {
-                            return e.ce_values;
-                        }
-                        throw(e);
-                    }
-                    return {};
+                    result = Value::New(l % r);
+                    return true;
+                case OpCode::Pow:
+                {
+                    IntT power;
+                    result = Operator::IntPow(l, r, power)
+                        ? Value::New(power)
+                        : Value::New(std::pow(static_cast<FloatT>(l), static_cast<FloatT>(r)));
+                    return true;
                 }
-                case SyntaxTree::NodeType::ElseStatement:
+                case OpCode::Greater:
+                    result = Value::New(l > r);
+                    return true;
+                case OpCode::GreaterEquel:
+                    result = Value::New(l >= r);
+                    return true;
+                case OpCode::Less:
+                    result = Value::New(l < r);
+                    return true;
+                case OpCode::LessEquel:
+                    result = Value::New(l <= r);
+                    return true;
+                default:
+                    return false;
+                }
+            }
+            if (left_type == Value::EType::String)
+            {
+                switch (op)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::ElseStatement>(_syntax_tree_node);
-                    try
+                case OpCode::Add:
+                    // r = r + x grows the string of r when nothing else holds it
+                    if (&left == &result && result.AppendString(right))
                     {
-                        (void)MakeChildNode(actual_node->block)->Execute(env);
+                        return true;
                     }
-                    catch (const ControlException & e)
+                    result = ValueData::ConcatString(left, right);
+                    return true;
+                case OpCode::Mul:
+                    if (right_type != Value::EType::Int || right->IntValue() <= 0)
                     {
-                        if (e.ce_type == ControlException::EType::Return)
-                        {
-                            return e.ce_values;
-                        }
-                        throw(e);
+                        return false;
                     }
-                    return {};
+                    result = left->RepeatString(static_cast<SizeT>(right->IntValue()));
+                    return true;
+                default:
+                    break;
                 }
-                case SyntaxTree::NodeType::WhileStatement:
+                if (right_type != Value::EType::String)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::WhileStatement>(_syntax_tree_node);
-                    try
-                    {
-                        while (true)
-                        {
-                            auto expr_value = GetValueFromList(MakeChildNode(actual_node->expr)->Execute(env));
-                            if (!expr_value->BoolValue())
-                            {
-                                break;
-                            }
-                            (void)MakeChildNode(actual_node->block)->Execute(env);
-                        }
-                    }
-                    catch (const ControlException & e)
-                    {
-                        if (e.ce_type != ControlException::EType::Break)
-                        {
-                            throw(e);
-                        }
-                    }
-                    return {};
+                    return false;
                 }
-                case SyntaxTree::NodeType::BreakStatement:
+                switch (op)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::BreakStatement>(_syntax_tree_node);
-                    throw(ControlException(ControlException::EType::Break));
-                    return {};
+                case OpCode::Greater:
+                    result = Value::New(left->CompareString(*right) > 0);
+                    return true;
+                case OpCode::GreaterEquel:
+                    result = Value::New(left->CompareString(*right) >= 0);
+                    return true;
+                case OpCode::Less:
+                    result = Value::New(left->CompareString(*right) < 0);
+                    return true;
+                case OpCode::LessEquel:
+                    result = Value::New(left->CompareString(*right) <= 0);
+                    return true;
+                default:
+                    return false;
                 }
-                case SyntaxTree::NodeType::ForStatement:
+            }
+            if (
+                (left_type == Value::EType::Int || left_type == Value::EType::Float)
+                && (right_type == Value::EType::Int || right_type == Value::EType::Float)
+            )
+            {
+                FloatT l = left_type == Value::EType::Int ? static_cast<FloatT>(left->IntValue()) : left->FloatValue();
+                FloatT r = right_type == Value::EType::Int ? static_cast<FloatT>(right->IntValue()) : right->FloatValue();
+                switch (op)
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::ForStatement>(_syntax_tree_node);
-                    // define params
-                    auto name_val_list = MakeChildNode(actual_node->var_name_list)->Execute(env);
-                    for (auto iter = name_val_list.begin(); iter != name_val_list.end(); ++iter)
-                    {
-                        SetValue(**iter, Value::New(), env);
-                    }
-                    auto expr_val = GetValueFromList(MakeChildNode(actual_node->expr)->Execute(env));
-                    //
-                    try
-                    {
-                        if (expr_val->GetType() == Value::EType::Array)
-                        {
-                            auto& array_data = expr_val->ArrayValue();
-                            for (auto iter = array_data.begin(); iter != array_data.end(); ++iter)
-                            {
-                                if (name_val_list.size() >= 1)
-                                {
-                                    SetValue(*name_val_list[0], *iter, env);
-                                }
-                                (void)MakeChildNode(actual_node->block)->Execute(env);
-                            }
-                        }
-                        else if (expr_val->GetType() == Value::EType::Dict)
-                        {
-                            auto& map_data = expr_val->DictValue();
-                            for (auto iter = map_data.begin(); iter != map_data.end(); ++iter)
-                            {
-                                if (name_val_list.size() >= 1)
-                                {
-                                    SetValue(*name_val_list[0], Value::New(iter->first), env);
-                                }
-                                if (name_val_list.size() >= 2)
-                                {
-                                    SetValue(*name_val_list[1], iter->second, env);
-                                }
-                                (void)MakeChildNode(actual_node->block)->Execute(env);
-                            }
-                        }
-                        else
-                        {
-                            throw(Exception(U"need a array or a Dict"));
-                        }
-                    }
-                    catch (const ControlException & e)
+                case OpCode::Add:
+                    result = Value::New(l + r);
+                    return true;
+                case OpCode::Sub:
+                    result = Value::New(l - r);
+                    return true;
+                case OpCode::Mul:
+                    result = Value::New(l * r);
+                    return true;
+                case OpCode::Div:
+                    result = Value::New(l / r);
+                    return true;
+                case OpCode::Pow:
+                    result = Value::New(std::pow(l, r));
+                    return true;
+                case OpCode::Greater:
+                    result = Value::New(l > r);
+                    return true;
+                case OpCode::GreaterEquel:
+                    result = Value::New(l >= r);
+                    return true;
+                case OpCode::Less:
+                    result = Value::New(l < r);
+                    return true;
+                case OpCode::LessEquel:
+                    result = Value::New(l <= r);
+                    return true;
+                default:
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        static bool FastUnary(Bytecode::OpCode op, const ValuePtr& val, ValuePtr& result)
+        {
+            using Bytecode::OpCode;
+            switch (op)
+            {
+            case OpCode::Not:
+                result = Value::New(!val->BoolValue());
+                return true;
+            case OpCode::BitwiseNot:
+                if (val->GetType() == Value::EType::Int)
+                {
+                    result = Value::New(~val->IntValue());
+                    return true;
+                }
+                return false;
+            case OpCode::Positive:
+                if (val->GetType() == Value::EType::Int || val->GetType() == Value::EType::Float)
+                {
+                    result = val;
+                    return true;
+                }
+                return false;
+            case OpCode::Negative:
+                if (val->GetType() == Value::EType::Int)
+                {
+                    result = Value::New(-val->IntValue());
+                    return true;
+                }
+                if (val->GetType() == Value::EType::Float)
+                {
+                    result = Value::New(-val->FloatValue());
+                    return true;
+                }
+                return false;
+            default:
+                return false;
+            }
+        }
+
+        // leaves all scopes of a frame, returns scope to the pool if it was not captured
+        static void LeaveScopes(SharedPtr<Scope>& scope, const SharedPtr<Scope>& upper_scope)
+        {
+            auto& pool = ScopePool::GetInstance();
+            while (scope && scope != upper_scope)
+            {
+                scope = pool.Release(scope);
+            }
+        }
+
+        static ValuePtrList Execute(const Bytecode::ProtoPtr& proto, const SharedPtr<Scope>& upper_scope, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            using Bytecode::OpCode;
+            auto& stack = Stack::GetInstance();
+            auto& values = stack.Values();
+            Frame frame(proto->max_stack);
+            const SizeT base = frame.Base();
+            #define R(x) values[base + (x)]
+            for (SizeT i = 0; i < proto->param_count; ++i)
+            {
+                R(i) = GetValueFromList(params, i);
+            }
+            auto& pool = ScopePool::GetInstance();
+            auto& list_pool = ValueListPool::GetInstance();
+            auto scope = upper_scope;
+            const auto& constants = proto->constants;
+            const Bytecode::Instruction* pc = proto->code.data();
+            SizeT top = 0;
+
+            while (true)
+            {
+                const auto& ins = *pc++;
+                switch (ins.Op())
+                {
+                case OpCode::Move:
+                    R(ins.A()) = R(ins.B());
+                    break;
+                case OpCode::LoadK:
+                    R(ins.A()) = constants[ins.Bx()];
+                    break;
+                case OpCode::LoadNil:
+                    for (SizeT i = 0; i < ins.B(); ++i)
                     {
-                        if (e.ce_type != ControlException::EType::Break)
-                        {
-                            throw(e);
-                        }
+                        R(ins.A() + i) = Value::New();
                     }
-                    return {};
-                }
-                case SyntaxTree::NodeType::ArrayStatement:
+                    break;
+                case OpCode::LoadArgs:
+                    R(ins.A()) = Value::New(params);
+                    break;
+                case OpCode::GetGlobal:
+                    R(ins.A()) = env.GetValue(*constants[ins.Bx()]);
+                    break;
+                case OpCode::SetGlobal:
+                    (void)env.AssignValue(*constants[ins.Bx()], R(ins.A()));
+                    break;
+                case OpCode::GetUpval:
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::ArrayStatement>(_syntax_tree_node);
-                    Value::ArrayT a;
-                    if (actual_node->expr_list)
+                    const auto& v = scope->Slot(ins.B(), ins.C());
+                    R(ins.A()) = v ? v : Value::New();
+                    break;
+                }
+                case OpCode::SetUpval:
+                    scope->Slot(ins.B(), ins.C()) = R(ins.A());
+                    break;
+                case OpCode::PushScope:
+                    scope = pool.New(scope, ins.A());
+                    break;
+                case OpCode::PopScope:
+                    for (SizeT i = 0; i < ins.A(); ++i)
                     {
-                        a = MakeChildNode(actual_node->expr_list)->Execute(env);
+                        scope = pool.Release(scope);
                     }
-                    return { Value::New(a) };
+                    break;
+                case OpCode::Closure:
+                    R(ins.A()) = MakeFunction(proto->protos[ins.Bx()], scope);
+                    break;
+                case OpCode::NewArray:
+                {
+                    auto end = ins.B() == 0 ? top : ins.A() + ins.B();
+                    // the elements sit in temporary registers, so they are moved rather than copied
+                    R(ins.A()) = Value::New(Value::ArrayT(
+                        std::make_move_iterator(values.begin() + base + ins.A() + 1),
+                        std::make_move_iterator(values.begin() + base + end)
+                    ));
+                    break;
                 }
-                case SyntaxTree::NodeType::MapStatement:
+                case OpCode::NewDict:
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::MapStatement>(_syntax_tree_node);
                     Value::DictT d;
-                    auto key_list = MakeChildNode(actual_node->key_expr_list)->Execute(env);
-                    auto val_list = MakeChildNode(actual_node->val_expr_list)->Execute(env);
-                    Assert(key_list.size() == val_list.size());
-                    for (SizeT i = 0; i < key_list.size() && i < val_list.size(); ++i)
+                    d.reserve(ins.B());
+                    for (SizeT i = 0; i < ins.B(); ++i)
                     {
-                        d[*key_list[i]] = val_list[i];
+                        d[std::move(R(ins.A() + 1 + i))] = std::move(R(ins.A() + 1 + ins.B() + i));
                     }
-                    return { Value::New(d) };
+                    R(ins.A()) = ValueData(std::move(d));
+                    break;
                 }
-                case SyntaxTree::NodeType::VarList:
+                case OpCode::SetMember:
+                    AssignMember(R(ins.A()), R(ins.B()), R(ins.C()), env);
+                    break;
+                case OpCode::GetMember:
+                case OpCode::BitwiseAnd:
+                case OpCode::And:
+                case OpCode::BitwiseOr:
+                case OpCode::Or:
+                case OpCode::Xor:
+                case OpCode::Add:
+                case OpCode::Sub:
+                case OpCode::Mul:
+                case OpCode::Div:
+                case OpCode::Mod:
+                case OpCode::Pow:
+                case OpCode::Equel:
+                case OpCode::Greater:
+                case OpCode::GreaterEquel:
+                case OpCode::Less:
+                case OpCode::LessEquel:
+                case OpCode::NotEquel:
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::VarList>(_syntax_tree_node);
-                    ValuePtrList var_value_list;
-                    for (auto iter = actual_node->vars.begin(); iter != actual_node->vars.end(); ++iter)
+                    if (!env.OperatorsOverridden() && FastBinary(ins.Op(), R(ins.B()), R(ins.C()), R(ins.A())))
                     {
-                        ValuePtrList var_vals = MakeChildNode(*iter)->Execute(env);
-                        var_value_list.insert(var_value_list.end(), var_vals.begin(), var_vals.end());
+                        break;
                     }
-                    return var_value_list;
+                    auto func_val = env.GetValue(Bytecode::OperatorFunctionName(ins.Op()));
+                    auto call_params = list_pool.New();
+                    call_params.push_back(R(ins.B()));
+                    call_params.push_back(R(ins.C()));
+                    R(ins.A()) = GetValueFromList(env.Call(func_val, call_params));
+                    list_pool.Release(call_params);
+                    break;
                 }
-                case SyntaxTree::NodeType::NameList:
+                case OpCode::BitwiseNot:
+                case OpCode::Not:
+                case OpCode::Positive:
+                case OpCode::Negative:
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::NameList>(_syntax_tree_node);
-                    ValuePtrList name_val_list;
-                    for (auto iter = actual_node->names.begin(); iter != actual_node->names.end(); ++iter)
+                    if (!env.OperatorsOverridden() && FastUnary(ins.Op(), R(ins.B()), R(ins.A())))
                     {
-                        Assert((*iter)->GetType() == ETokenType::Id);
-                        name_val_list.push_back(Value::New((*iter)->StringValue()));
+                        break;
                     }
-                    return name_val_list;
+                    auto func_val = env.GetValue(Bytecode::OperatorFunctionName(ins.Op()));
+                    auto call_params = list_pool.New();
+                    call_params.push_back(R(ins.B()));
+                    R(ins.A()) = GetValueFromList(env.Call(func_val, call_params));
+                    list_pool.Release(call_params);
+                    break;
                 }
-                case SyntaxTree::NodeType::ExpressionList:
+                case OpCode::Call:
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::ExpressionList>(_syntax_tree_node);
-                    ValuePtrList values;
-                    ValuePtrList temp_values;
-                    for (auto iter = actual_node->exprs.begin(); iter != actual_node->exprs.end(); ++iter)
+                    auto a = ins.A();
+                    auto end = ins.B() == 0 ? top : a + ins.B();
+                    auto call_params = list_pool.New();
+                    // argument registers are temporaries, nothing reads them after the call
+                    call_params.assign(
+                        std::make_move_iterator(values.begin() + base + a + 1),
+                        std::make_move_iterator(values.begin() + base + end)
+                    );
+                    auto results = env.Call(R(a), call_params);
+                    list_pool.Release(call_params);
+                    if (ins.C() == 0)
                     {
-                        temp_values = MakeChildNode(*iter)->Execute(env);
-                        values.push_back(GetValueFromList(temp_values));
+                        // an open value list always has one value at least
+                        auto count = results.empty() ? 1 : results.size();
+                        stack.Grow(base + a + count);
+                        for (SizeT i = 0; i < count; ++i)
+                        {
+                            R(a + i) = TakeValueFromList(results, i);
+                        }
+                        top = a + count;
                     }
-                    if (temp_values.size() > 1)
+                    else
                     {
-                        values.insert(values.end(), temp_values.begin() + 1, temp_values.end());
-                    }
-                    return values;
-                }
-                case SyntaxTree::NodeType::BinaryExpression:
-                {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::BinaryExpression>(_syntax_tree_node);
-                    auto func_val = GetValue(*actual_node->op->OperatorFunctionName(), env);
-                    return env.Call(
-                        func_val,
+                        for (SizeT i = 0; i + 1 < ins.C(); ++i)
                         {
-                            GetValueFromList(MakeChildNode(actual_node->left)->Execute(env)),
-                            GetValueFromList(MakeChildNode(actual_node->right)->Execute(env))
+                            R(a + i) = TakeValueFromList(results, i);
                         }
-                    );
+                    }
+                    list_pool.Release(results);
+                    break;
                 }
-                case SyntaxTree::NodeType::UnaryExpression:
+                case OpCode::Return:
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::UnaryExpression>(_syntax_tree_node);
-                    auto func_val = GetValue(*actual_node->op->OperatorFunctionName(false), env);
-                    return env.Call(
-                        func_val,
-                        {
-                            GetValueFromList(MakeChildNode(actual_node->expr)->Execute(env))
-                        }
+                    auto end = ins.B() == 0 ? top : ins.A() + ins.B() - 1;
+                    LeaveScopes(scope, upper_scope);
+                    auto results = list_pool.New();
+                    // the frame is left, its registers are dead
+                    results.assign(
+                        std::make_move_iterator(values.begin() + base + ins.A()),
+                        std::make_move_iterator(values.begin() + base + end)
                     );
+                    return results;
                 }
-                case SyntaxTree::NodeType::VarExpression:
+                case OpCode::MoveList:
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::VarExpression>(_syntax_tree_node);
-                    ValuePtr key_val = GetValueFromList(MakeChildNode(actual_node->key)->Execute(env));
-                    ValuePtr expr_val = Value::New();
-                    if (actual_node->expr)
+                    auto count = top - ins.B();
+                    for (SizeT i = 0; i < count; ++i)
                     {
-                        expr_val = GetValueFromList(MakeChildNode(actual_node->expr)->Execute(env));
+                        R(ins.A() + i) = std::move(R(ins.B() + i));
                     }
-                    return { key_val, expr_val };
+                    top = ins.A() + count;
+                    break;
                 }
-                case SyntaxTree::NodeType::Terminator:
+                case OpCode::SetTop:
+                    top = ins.A();
+                    break;
+                case OpCode::Adjust:
                 {
-                    auto actual_node = std::static_pointer_cast<SyntaxTree::Terminator>(_syntax_tree_node);
-                    if (actual_node->token->GetType() == ETokenType::Id)
+                    auto end = ins.A() + ins.B();
+                    for (SizeT i = top; i < end; ++i)
                     {
-                        return { GetValue(actual_node->token->StringValue(), env) };
+                        R(i) = Value::New();
                     }
-                    return { Value::New(actual_node->token) };
+                    break;
                 }
+                case OpCode::Jmp:
+                    pc += ins.SBx();
+                    break;
+                case OpCode::JmpIfNot:
+                    if (!R(ins.A())->BoolValue())
+                    {
+                        pc += ins.SBx();
+                    }
+                    break;
+                case OpCode::ForPrep:
+                    if (!Iterator::Iterable(R(ins.A())))
+                    {
+                        throw(Exception(U"need a iterable value"));
+                    }
+                    R(ins.A() + 1) = nullptr;
+                    pc += ins.SBx();
+                    break;
+                case OpCode::ForLoop:
+                    if (ForNext(values, base + ins.A(), env))
+                    {
+                        pc += ins.SBx();
+                    }
+                    break;
                 default:
+                    throw(Exception(U"Invalid instruction"));
                     break;
                 }
-                return {};
-            }
-
-        private:
-            SyntaxTree::NodePtr _syntax_tree_node;
-            TMap<ValueData, ValuePtr> _node_env;
-            Node* _parent;
-            TVector<SharedPtr<Node>> _children;
-        };
-
-        static ValuePtr GetValueFromList(const ValuePtrList& values, SizeT index)
-        {
-            if (values.size() <= index)
-            {
-                return Value::New();
-            }
-            return values[index];
-        }
-        
-        static ValuePtrList ChunkCall(SharedPtr<Node> block, EnvironmentInterface& env, const ValuePtrList& params)
-        {
-            // define params
-            block->SetValue(U"args", Value::New(params), env);
-
-            // run func
-            try
-            {
-                Assert(block->Execute(env).empty());
-            }
-            catch (const ControlException & e)
-            {
-                if (e.ce_type == ControlException::EType::Return)
-                {
-                    return e.ce_values;
-                }
-                throw(Exception(U"Unexcept ControlException"));
-            }
-            return {};
-        }
-
-        static ValuePtrList FunctionCall(SharedPtr<Node> block, EnvironmentInterface& env, const ValuePtrList& params, const ValuePtrList& param_names)
-        {
-            // define params
-            for (SizeT i = 0; i < param_names.size(); ++i)
-            {
-                block->SetValue(*param_names[i], GetValueFromList(params, i), env);
-            }
-
-            // run func
-            try
-            {
-                Assert(block->Execute(env).empty());
-            }
-            catch (const ControlException & e)
-            {
-                if (e.ce_type == ControlException::EType::Return)
-                {
-                    return e.ce_values;
-                }
-                throw(Exception(U"Unexcept ControlException"));
             }
+            #undef R
             return {};
         }
     }
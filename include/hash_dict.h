@@ -0,0 +1,314 @@
+#pragma once
+#include "pre_define.h"
+
+namespace LANG_NS
+{
+    // open addressing hash table that iterates in insertion order
+    //  - entries are kept in a vector in the order they were added, erased entries are marked dead
+    //  - the index is a power of two table of entry positions, probed linearly
+    //  - keys need 'SizeT Hash() const' and '=='
+    //  - erasing while iterating is safe, keys added while iterating may be visited
+    //  - positions are insertion serials, growing the table and dropping dead entries keeps them valid
+    template < typename KeyType, typename ValueType >
+    class HashDict
+    {
+    public:
+        class Entry
+        {
+        public:
+            KeyType first;
+            ValueType second;
+            SizeT hash = 0;
+            // insertion order, never reused, so it survives dropping dead entries before it
+            SizeT serial = 0;
+            bool alive = true;
+        };
+
+        template < typename EntryType >
+        class Iterator
+        {
+        public:
+            Iterator(EntryType* entry, EntryType* end)
+                : _entry(entry)
+                , _end(end)
+            {
+                SkipDead();
+            }
+
+            EntryType& operator*() const
+            {
+                return *_entry;
+            }
+
+            EntryType* operator->() const
+            {
+                return _entry;
+            }
+
+            Iterator& operator++()
+            {
+                ++_entry;
+                SkipDead();
+                return *this;
+            }
+
+            bool operator==(const Iterator& rhs) const
+            {
+                return _entry == rhs._entry;
+            }
+
+            bool operator!=(const Iterator& rhs) const
+            {
+                return _entry != rhs._entry;
+            }
+
+        private:
+            void SkipDead()
+            {
+                while (_entry != _end && !_entry->alive)
+                {
+                    ++_entry;
+                }
+            }
+
+        private:
+            EntryType* _entry;
+            EntryType* _end;
+        };
+
+        using iterator = Iterator<Entry>;
+        using const_iterator = Iterator<const Entry>;
+
+    public:
+        HashDict() = default;
+
+        HashDict(std::initializer_list<std::pair<KeyType, ValueType>> items)
+        {
+            reserve(items.size());
+            for (auto iter = items.begin(); iter != items.end(); ++iter)
+            {
+                (*this)[iter->first] = iter->second;
+            }
+        }
+
+        SizeT size() const
+        {
+            return _size;
+        }
+
+        bool empty() const
+        {
+            return _size == 0;
+        }
+
+        iterator begin()
+        {
+            return iterator(_entries.data(), _entries.data() + _entries.size());
+        }
+
+        iterator end()
+        {
+            return iterator(_entries.data() + _entries.size(), _entries.data() + _entries.size());
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator(_entries.data(), _entries.data() + _entries.size());
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator(_entries.data() + _entries.size(), _entries.data() + _entries.size());
+        }
+
+        // the first live entry at or after a position
+        const_iterator FromPosition(SizeT position) const
+        {
+            // serials match indexes until dead entries are dropped
+            auto index = position;
+            if (index >= _entries.size() || _entries[index].serial != position)
+            {
+                index = static_cast<SizeT>(std::lower_bound(
+                    _entries.begin(), _entries.end(), position,
+                    [](const Entry& entry, SizeT serial) { return entry.serial < serial; }
+                ) - _entries.begin());
+            }
+            return const_iterator(_entries.data() + index, _entries.data() + _entries.size());
+        }
+
+        SizeT Position(const const_iterator& iter) const
+        {
+            return iter->serial;
+        }
+
+        iterator find(const KeyType& key)
+        {
+            auto position = Lookup(key, key.Hash());
+            return position == NotFound ? end() : iterator(_entries.data() + position, _entries.data() + _entries.size());
+        }
+
+        const_iterator find(const KeyType& key) const
+        {
+            auto position = Lookup(key, key.Hash());
+            return position == NotFound ? end() : const_iterator(_entries.data() + position, _entries.data() + _entries.size());
+        }
+
+        ValueType& operator[](const KeyType& key)
+        {
+            auto hash = key.Hash();
+            auto position = Lookup(key, hash);
+            if (position != NotFound)
+            {
+                return _entries[position].second;
+            }
+            return Insert(key, hash).second;
+        }
+
+        // a missing key is moved into the table instead of copied
+        ValueType& operator[](KeyType&& key)
+        {
+            auto hash = key.Hash();
+            auto position = Lookup(key, hash);
+            if (position != NotFound)
+            {
+                return _entries[position].second;
+            }
+            return Insert(std::move(key), hash).second;
+        }
+
+        SizeT erase(const KeyType& key)
+        {
+            if (_size == 0)
+            {
+                return 0;
+            }
+            auto hash = key.Hash();
+            auto mask = _index.size() - 1;
+            for (auto slot = hash & mask; _index[slot] != EmptySlot; slot = (slot + 1) & mask)
+            {
+                auto position = _index[slot];
+                if (position == DeletedSlot || _entries[position].hash != hash || !(_entries[position].first == key))
+                {
+                    continue;
+                }
+                _index[slot] = DeletedSlot;
+                auto& entry = _entries[position];
+                entry.first = KeyType();
+                entry.second = ValueType();
+                entry.alive = false;
+                --_size;
+                return 1;
+            }
+            return 0;
+        }
+
+        void reserve(SizeT count)
+        {
+            if (count * 4 > _index.size() * 3)
+            {
+                Rebuild(count);
+            }
+            _entries.reserve(count);
+        }
+
+        void clear()
+        {
+            _entries.clear();
+            _index.clear();
+            _size = 0;
+        }
+
+    private:
+        using SlotT = std::uint32_t;
+        static constexpr SlotT EmptySlot = static_cast<SlotT>(-1);
+        static constexpr SlotT DeletedSlot = static_cast<SlotT>(-2);
+        static constexpr SizeT NotFound = static_cast<SizeT>(-1);
+        static constexpr SizeT MinIndexSize = 8;
+
+        SizeT Lookup(const KeyType& key, SizeT hash) const
+        {
+            if (_size == 0)
+            {
+                return NotFound;
+            }
+            auto mask = _index.size() - 1;
+            for (auto slot = hash & mask; _index[slot] != EmptySlot; slot = (slot + 1) & mask)
+            {
+                auto position = _index[slot];
+                if (position != DeletedSlot && _entries[position].hash == hash && _entries[position].first == key)
+                {
+                    return position;
+                }
+            }
+            return NotFound;
+        }
+
+        // key must not be in the table
+        template < typename K >
+        Entry& Insert(K&& key, SizeT hash)
+        {
+            // dead entries keep their slot as a tombstone, so they count against the load factor
+            if ((_entries.size() + 1) * 4 > _index.size() * 3)
+            {
+                Rebuild((_size + 1) * 2);
+            }
+            auto mask = _index.size() - 1;
+            auto slot = hash & mask;
+            while (_index[slot] != EmptySlot && _index[slot] != DeletedSlot)
+            {
+                slot = (slot + 1) & mask;
+            }
+            _index[slot] = static_cast<SlotT>(_entries.size());
+            _entries.push_back(Entry());
+            auto& entry = _entries.back();
+            entry.first = std::forward<K>(key);
+            entry.hash = hash;
+            entry.serial = _next_serial++;
+            ++_size;
+            return entry;
+        }
+
+        // drops dead entries and sizes the index for count live entries
+        void Rebuild(SizeT count)
+        {
+            if (_size != _entries.size())
+            {
+                SizeT live = 0;
+                for (SizeT i = 0; i < _entries.size(); ++i)
+                {
+                    if (_entries[i].alive)
+                    {
+                        if (live != i)
+                        {
+                            _entries[live] = std::move(_entries[i]);
+                        }
+                        ++live;
+                    }
+                }
+                _entries.erase(_entries.begin() + live, _entries.end());
+            }
+            auto index_size = MinIndexSize;
+            while (count * 4 > index_size * 3)
+            {
+                index_size *= 2;
+            }
+            _index.assign(index_size, EmptySlot);
+            auto mask = index_size - 1;
+            for (SizeT i = 0; i < _entries.size(); ++i)
+            {
+                auto slot = _entries[i].hash & mask;
+                while (_index[slot] != EmptySlot)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                _index[slot] = static_cast<SlotT>(i);
+            }
+        }
+
+    private:
+        TVector<Entry> _entries;
+        TVector<SlotT> _index;
+        SizeT _size = 0;
+        SizeT _next_serial = 0;
+    };
+}
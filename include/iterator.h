@@ -0,0 +1,209 @@
+#pragma once
+#include <cmath>
+#include "pre_define.h"
+#include "value.h"
+
+namespace LANG_NS
+{
+    // walks a value one step at a time without building its elements first
+    //  - arrays, typed arrays, strings and ranges give one element per step, dicts give key and value in insertion order
+    //  - state must be a null handle before the first step, then it is the position reached or, for integer ranges, the last number
+    //  - functions are iterators too, they are called until their first result is nil, see Executor::ForNext
+    namespace Iterator
+    {
+        static bool Iterable(const ValuePtr& v)
+        {
+            switch (v->GetType())
+            {
+            case Value::EType::String:
+            case Value::EType::Array:
+            case Value::EType::Dict:
+            case Value::EType::Function:
+            case Value::EType::IntArray:
+            case Value::EType::FloatArray:
+            case Value::EType::Range:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        // |a - b| without overflow
+        static unsigned long long Distance(IntT a, IntT b)
+        {
+            return a < b
+                ? static_cast<unsigned long long>(b) - static_cast<unsigned long long>(a)
+                : static_cast<unsigned long long>(a) - static_cast<unsigned long long>(b);
+        }
+
+        static bool RangeEmpty(const Value::RangeT& range)
+        {
+            if (range.interger)
+            {
+                return range.interval.i > 0 ? range.begin.i > range.end.i : range.begin.i < range.end.i;
+            }
+            return range.interval.f > 0 ? range.begin.f > range.end.f : range.begin.f < range.end.f;
+        }
+
+        // float elements are begin + index * interval everywhere, so no error builds up along the range
+        static FloatT FloatRangeAt(const Value::RangeT& range, SizeT index)
+        {
+            return range.begin.f + static_cast<FloatT>(index) * range.interval.f;
+        }
+
+        static bool FloatRangeContains(const Value::RangeT& range, FloatT f)
+        {
+            return range.interval.f > 0 ? f <= range.end.f : f >= range.end.f;
+        }
+
+        static SizeT RangeSize(const Value::RangeT& range)
+        {
+            if (RangeEmpty(range))
+            {
+                return 0;
+            }
+            if (range.interger)
+            {
+                return static_cast<SizeT>(Distance(range.begin.i, range.end.i) / Distance(range.interval.i, 0) + 1);
+            }
+            auto steps = std::floor((range.end.f - range.begin.f) / range.interval.f);
+            if (std::isnan(steps))
+            {
+                return 0;
+            }
+            // more elements than a float index can tell apart
+            if (steps >= 9007199254740992.0)
+            {
+                return static_cast<SizeT>(1) << 53;
+            }
+            // the division may round either way, the count is the first index past end
+            auto size = static_cast<SizeT>(steps) + 1;
+            while (FloatRangeContains(range, FloatRangeAt(range, size)))
+            {
+                ++size;
+            }
+            while (size > 0 && !FloatRangeContains(range, FloatRangeAt(range, size - 1)))
+            {
+                --size;
+            }
+            return size;
+        }
+
+        // nil past the end
+        static ValuePtr RangeAt(const Value::RangeT& range, SizeT index)
+        {
+            if (index >= RangeSize(range))
+            {
+                return Value::New();
+            }
+            if (range.interger)
+            {
+                return Value::New(static_cast<IntT>(
+                    static_cast<unsigned long long>(range.begin.i)
+                    + static_cast<unsigned long long>(index) * static_cast<unsigned long long>(range.interval.i)
+                ));
+            }
+            return Value::New(FloatRangeAt(range, index));
+        }
+
+        // moves state to the next number and sets value to it, false past the end
+        //  - float ranges keep the index in state
+        static bool RangeNext(const Value::RangeT& range, ValuePtr& state, ValuePtr& value)
+        {
+            if (range.interger)
+            {
+                auto next = range.begin.i;
+                if (state)
+                {
+                    auto current = state->IntValue();
+                    if (Distance(current, range.end.i) < Distance(range.interval.i, 0))
+                    {
+                        return false;
+                    }
+                    next = static_cast<IntT>(static_cast<unsigned long long>(current) + static_cast<unsigned long long>(range.interval.i));
+                }
+                else if (RangeEmpty(range))
+                {
+                    return false;
+                }
+                state = Value::New(next);
+                value = state;
+                return true;
+            }
+            SizeT index = state ? static_cast<SizeT>(state->IntValue()) + 1 : 0;
+            if (index >= RangeSize(range))
+            {
+                return false;
+            }
+            state = Value::New(index);
+            value = Value::New(FloatRangeAt(range, index));
+            return true;
+        }
+
+        static SizeT Size(const ValuePtr& v)
+        {
+            switch (v->GetType())
+            {
+            case Value::EType::String:
+                return v->StringSize();
+            case Value::EType::Array:
+                return v->ArrayValue().size();
+            default:
+                return v->TypedArraySize();
+            }
+        }
+
+        static ValuePtr At(const ValuePtr& v, SizeT index)
+        {
+            switch (v->GetType())
+            {
+            case Value::EType::String:
+                return Value::New(StringT(1, v->StringAt(index)));
+            case Value::EType::Array:
+            {
+                auto& array_data = v->ArrayValue();
+                return array_data[index] ? array_data[index] : Value::New();
+            }
+            default:
+                return v->TypedArrayAt(index);
+            }
+        }
+
+        // one step over any iterable value but a function, false at the end
+        static bool Next(const ValuePtr& container, ValuePtr& state, ValuePtr& first, ValuePtr& second)
+        {
+            if (container->GetType() == Value::EType::Range)
+            {
+                if (!RangeNext(container->RangeValue(), state, first))
+                {
+                    return false;
+                }
+                second = Value::New();
+                return true;
+            }
+            if (container->GetType() == Value::EType::Dict)
+            {
+                // the position of the last entry
+                auto& map_data = container->DictValue();
+                auto iter = map_data.FromPosition(state ? static_cast<SizeT>(state->IntValue()) + 1 : 0);
+                if (iter == map_data.end())
+                {
+                    return false;
+                }
+                state = Value::New(map_data.Position(iter));
+                first = iter->first;
+                second = iter->second;
+                return true;
+            }
+            SizeT index = state ? static_cast<SizeT>(state->IntValue()) + 1 : 0;
+            if (index >= Size(container))
+            {
+                return false;
+            }
+            state = Value::New(index);
+            first = At(container, index);
+            second = Value::New();
+            return true;
+        }
+    }
+}
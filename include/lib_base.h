@@ -1,6 +1,9 @@
 #pragma once
 #include "environment_interface.h"
+#include "iterator.h"
 #include "lib_array.h"
+#include "lib_typed_array.h"
+#include "operator.h"
 #include "pre_define.h"
 
 namespace LANG_NS
@@ -127,6 +130,12 @@ namespace LANG_NS
             }
             ValuePtr left = params[0];
             ValuePtr right = params[1];
+            if (left->IsTypedArray() || right->IsTypedArray())
+            {
+                ValuePtr result;
+                TypedArray::ElementWise(TypedArray::EOp::Add, left, right, result);
+                return {result};
+            }
             if (left->GetType() == Value::EType::Int)
             {
                 if (right->GetType() == Value::EType::Int)
@@ -151,7 +160,7 @@ namespace LANG_NS
             }
             else if (left->GetType() == Value::EType::String)
             {
-                return {Value::New(left->StringValue() + right->ToString())};
+                return {ValueData::ConcatString(left, right)};
             }
             throw(Exception(U"__Add Invalid params"));
             return {};
@@ -206,6 +215,12 @@ namespace LANG_NS
             }
             ValuePtr left = params[0];
             ValuePtr right = params[1];
+            if (left->IsTypedArray() || right->IsTypedArray())
+            {
+                ValuePtr result;
+                TypedArray::ElementWise(TypedArray::EOp::Sub, left, right, result);
+                return {result};
+            }
             if (left->GetType() == Value::EType::Int)
             {
                 if (right->GetType() == Value::EType::Int)
@@ -241,6 +256,12 @@ namespace LANG_NS
             }
             ValuePtr left = params[0];
             ValuePtr right = params[1];
+            if (left->IsTypedArray() || right->IsTypedArray())
+            {
+                ValuePtr result;
+                TypedArray::ElementWise(TypedArray::EOp::Mul, left, right, result);
+                return {result};
+            }
             if (left->GetType() == Value::EType::Int)
             {
                 if (right->GetType() == Value::EType::Int)
@@ -269,13 +290,7 @@ namespace LANG_NS
                 {
                     if (right->IntValue() > 0)
                     {
-                        StringT temp;
-                        temp.reserve(left->StringValue().size() * static_cast<SizeT>(right->IntValue()));
-                        for (IntT i = 0; i < right->IntValue(); ++i)
-                        {
-                            temp += left->StringValue();
-                        }
-                        return { Value::New(temp) };
+                        return { left->RepeatString(static_cast<SizeT>(right->IntValue())) };
                     }
                 }
             }
@@ -292,6 +307,12 @@ namespace LANG_NS
             }
             ValuePtr left = params[0];
             ValuePtr right = params[1];
+            if (left->IsTypedArray() || right->IsTypedArray())
+            {
+                ValuePtr result;
+                TypedArray::ElementWise(TypedArray::EOp::Div, left, right, result);
+                return {result};
+            }
             if (left->GetType() == Value::EType::Int)
             {
                 if (right->GetType() == Value::EType::Int)
@@ -337,6 +358,46 @@ namespace LANG_NS
             return {};
         }
 
+        static ValuePtrList __Pow(EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            if (params.size() != 2)
+            {
+                throw(Exception(U"__Pow must be two params"));
+                return {};
+            }
+            ValuePtr left = params[0];
+            ValuePtr right = params[1];
+            if (left->GetType() == Value::EType::Int)
+            {
+                if (right->GetType() == Value::EType::Int)
+                {
+                    IntT power;
+                    if (Operator::IntPow(left->IntValue(), right->IntValue(), power))
+                    {
+                        return {Value::New(power)};
+                    }
+                    return {Value::New(std::pow((FloatT)left->IntValue(), (FloatT)right->IntValue()))};
+                }
+                else if (right->GetType() == Value::EType::Float)
+                {
+                    return {Value::New(std::pow((FloatT)left->IntValue(), right->FloatValue()))};
+                }
+            }
+            else if (left->GetType() == Value::EType::Float)
+            {
+                if (right->GetType() == Value::EType::Int)
+                {
+                    return {Value::New(std::pow(left->FloatValue(), (FloatT)right->IntValue()))};
+                }
+                else if (right->GetType() == Value::EType::Float)
+                {
+                    return {Value::New(std::pow(left->FloatValue(), right->FloatValue()))};
+                }
+            }
+            throw(Exception(U"__Pow Invalid params"));
+            return {};
+        }
+
         static ValuePtrList __Equel(EnvironmentInterface& env, const ValuePtrList& params)
         {
             if (params.size() != 2)
@@ -384,7 +445,7 @@ namespace LANG_NS
             {
                 if (right->GetType() == Value::EType::String)
                 {
-                    return {Value::New(left->StringValue() > right->StringValue())};
+                    return {Value::New(left->CompareString(*right) > 0)};
                 }
             }
             throw(Exception(U"__Greater Invalid params"));
@@ -426,7 +487,7 @@ namespace LANG_NS
             {
                 if (right->GetType() == Value::EType::String)
                 {
-                    return {Value::New(left->StringValue() >= right->StringValue())};
+                    return {Value::New(left->CompareString(*right) >= 0)};
                 }
             }
             throw(Exception(U"__GreaterEquel Invalid params"));
@@ -468,7 +529,7 @@ namespace LANG_NS
             {
                 if (right->GetType() == Value::EType::String)
                 {
-                    return {Value::New(left->StringValue() < right->StringValue())};
+                    return {Value::New(left->CompareString(*right) < 0)};
                 }
             }
             throw(Exception(U"__Less Invalid params"));
@@ -510,7 +571,7 @@ namespace LANG_NS
             {
                 if (right->GetType() == Value::EType::String)
                 {
-                    return {Value::New(left->StringValue() <= right->StringValue())};
+                    return {Value::New(left->CompareString(*right) <= 0)};
                 }
             }
             throw(Exception(U"__LessEquel Invalid params"));
@@ -561,6 +622,32 @@ namespace LANG_NS
                 }
                 return {Value::New()};
             }
+            else if (left->IsTypedArray())
+            {
+                if (right->GetType() == Value::EType::String)
+                {
+                    auto func = TypedArrayLib::GetFunc(left, right->StringValue());
+                    if (func)
+                    {
+                        return {func};
+                    }
+                }
+                if (right->GetType() != Value::EType::Int)
+                {
+                    throw(Exception(U"__GetMember key of array must be a interger"));
+                    return {};
+                }
+                return {left->TypedArrayAt(static_cast<SizeT>(right->IntValue()))};
+            }
+            else if (left->GetType() == Value::EType::Range)
+            {
+                if (right->GetType() != Value::EType::Int)
+                {
+                    throw(Exception(U"__GetMember key of range must be a interger"));
+                    return {};
+                }
+                return {Iterator::RangeAt(left->RangeValue(), static_cast<SizeT>(right->IntValue()))};
+            }
             else if (left->GetType() == Value::EType::Dict)
             {
                 auto& map_data = left->DictValue();
@@ -716,6 +803,14 @@ namespace LANG_NS
             {
                 return {Value::New(param->DictValue().size())};
             }
+            else if (param->IsTypedArray())
+            {
+                return {Value::New(param->TypedArraySize())};
+            }
+            else if (param->GetType() == Value::EType::Range)
+            {
+                return {Value::New(Iterator::RangeSize(param->RangeValue()))};
+            }
             else
             {
                 throw(Exception(U"Len param must be a array or a map"));
@@ -840,7 +935,7 @@ namespace LANG_NS
                     end.f = params[1]->FloatValue();
                 }
             }
-            else if (params.size() > 3)
+            else if (params.size() >= 3)
             {
                 if (
                     params[0]->GetType() != Value::EType::Int
@@ -921,62 +1016,105 @@ namespace LANG_NS
                 }
             }
 
-            Value::ArrayT array_data;
+            // the bounds are checked now, the numbers are made as the range is walked
+            Value::RangeT range;
+            range.interger = interger;
             if (interger)
             {
-                if (begin.i <= end.i)
-                {
-                    if (interval.i <= 0)
-                    {
-                        throw(Exception(U"Len Invalid interval"));
-                        return {};
-                    }
-                    for (IntT i = begin.i; i <= end.i; i += interval.i)
-                    {
-                        array_data.push_back(Value::New(i));
-                    }
-                }
-                else
+                if (begin.i <= end.i ? interval.i <= 0 : interval.i >= 0)
                 {
-                    if (interval.i >= 0)
-                    {
-                        throw(Exception(U"Len Invalid interval"));
-                        return {};
-                    }
-                    for (IntT i = begin.i; i >= end.i; i += interval.i)
-                    {
-                        array_data.push_back(Value::New(i));
-                    }
+                    throw(Exception(U"Len Invalid interval"));
+                    return {};
                 }
+                range.begin.i = begin.i;
+                range.end.i = end.i;
+                range.interval.i = interval.i;
             }
             else
             {
-                if (begin.f <= end.f)
+                if (begin.f <= end.f ? interval.f <= 0 : interval.f >= 0)
                 {
-                    if (interval.f <= 0)
-                    {
-                        throw(Exception(U"Len Invalid interval"));
-                        return {};
-                    }
-                    for (FloatT i = begin.f; i <= end.f; i += interval.f)
-                    {
-                        array_data.push_back(Value::New(i));
-                    }
+                    throw(Exception(U"Len Invalid interval"));
+                    return {};
                 }
-                else
+                range.begin.f = begin.f;
+                range.end.f = end.f;
+                range.interval.f = interval.f;
+            }
+            return {Value::New(range)};
+        }
+
+        class IterState
+        {
+        public:
+            ValuePtr container;
+            ValuePtr state = nullptr;
+        };
+
+        static ValuePtrList IterNext(SharedPtr<IterState> iter, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            (void)params;
+            ValuePtr first;
+            ValuePtr second;
+            if (!Iterator::Next(iter->container, iter->state, first, second))
+            {
+                return {Value::New()};
+            }
+            return {first, second};
+        }
+
+        // iter(v) : a function giving the next element of v on each call, or key and value for dicts, nil at the end
+        static ValuePtrList Iter(EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            if (params.size() != 1 || !Iterator::Iterable(params[0]))
+            {
+                throw(Exception(U"Iter need a iterable param"));
+                return {};
+            }
+            if (params[0]->GetType() == Value::EType::Function)
+            {
+                return {params[0]};
+            }
+            auto iter = MakeShared<IterState>();
+            iter->container = params[0];
+            return {Value::New(Value::FunctionT(std::bind(IterNext, iter, std::placeholders::_1, std::placeholders::_2)))};
+        }
+
+        // array(v) : the elements of an iterable value in a new array, the keys for a dict
+        static ValuePtrList ToArray(EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            if (params.size() != 1 || !Iterator::Iterable(params[0]))
+            {
+                throw(Exception(U"Array need a iterable param"));
+                return {};
+            }
+            auto& source = params[0];
+            Value::ArrayT array_data;
+            if (source->GetType() == Value::EType::Function)
+            {
+                while (true)
                 {
-                    if (interval.f >= 0)
-                    {
-                        throw(Exception(U"Len Invalid interval"));
-                        return {};
-                    }
-                    for (FloatT i = begin.f; i >= end.f; i += interval.f)
+                    auto results = env.Call(source, {});
+                    if (results.empty() || !results[0] || results[0]->GetType() == Value::EType::Nil)
                     {
-                        array_data.push_back(Value::New(i));
+                        break;
                     }
+                    array_data.push_back(std::move(results[0]));
                 }
+                return {ValueData(std::move(array_data))};
+            }
+            if (source->GetType() == Value::EType::Range)
+            {
+                array_data.reserve(Iterator::RangeSize(source->RangeValue()));
+            }
+            ValuePtr state = nullptr;
+            ValuePtr first;
+            ValuePtr second;
+            while (Iterator::Next(source, state, first, second))
+            {
+                array_data.push_back(std::move(first));
             }
-            return {Value::New(array_data)};
+            return {ValueData(std::move(array_data))};
         }
 
         static ValuePtrList Print(EnvironmentInterface& env, const ValuePtrList& params)
@@ -1015,6 +1153,7 @@ namespace LANG_NS
                 {U"__mul", __Mul},
                 {U"__div", __Div},
                 {U"__mod", __Mod},
+                {U"__pow", __Pow},
                 {U"__equel", __Equel},
                 {U"__greater", __Greater},
                 {U"__greater_equel", __GreaterEquel},
@@ -1030,6 +1169,8 @@ namespace LANG_NS
                 {U"type", Type},
                 {U"len", Len},
                 {U"range", Range},
+                {U"iter", Iter},
+                {U"array", ToArray},
                 {U"print", Print},
                 {U"println", Println},
             });
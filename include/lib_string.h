@@ -0,0 +1,74 @@
+#pragma once
+#include "environment_interface.h"
+#include "pre_define.h"
+
+namespace LANG_NS
+{
+    namespace StringLib
+    {
+        // the buffer is a string value, so it stays narrow as long as the appended text is
+        using BufferPtr = SharedPtr<ValuePtr>;
+
+        static ValuePtrList Append(BufferPtr buffer, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            for (auto iter = params.begin(); iter != params.end(); ++iter)
+            {
+                // a string returned by build() shares the cell, the first append after it copies
+                if (!buffer->AppendString(*iter))
+                {
+                    *buffer = ValueData::ConcatString(*buffer, *iter);
+                }
+            }
+            return {};
+        }
+
+        static ValuePtrList Size(BufferPtr buffer, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            (void)params;
+            return {Value::New(buffer->StringSize())};
+        }
+
+        static ValuePtrList Build(BufferPtr buffer, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            (void)params;
+            return {*buffer};
+        }
+
+        static ValuePtrList Clear(BufferPtr buffer, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            (void)params;
+            *buffer = Value::New(StringT());
+            return {};
+        }
+
+        // string.builder(...) : a dict of functions sharing one growing buffer, the params are appended first
+        //  - append(...) adds every param, strings as they are and other values as they print
+        //  - size() is the number of characters so far
+        //  - build() returns the string built so far
+        //  - clear() empties the buffer
+        static ValuePtrList Builder(EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            auto buffer = MakeShared<ValuePtr>(Value::New(StringT()));
+            (void)Append(buffer, env, params);
+            auto bind = [&buffer](ValuePtrList(*func)(BufferPtr, EnvironmentInterface&, const ValuePtrList&))
+            {
+                return Value::New(std::bind(func, buffer, std::placeholders::_1, std::placeholders::_2));
+            };
+            Value::DictT builder = {
+                {U"append", bind(Append)},
+                {U"size", bind(Size)},
+                {U"build", bind(Build)},
+                {U"clear", bind(Clear)},
+            };
+            return {Value::New(builder)};
+        }
+
+        static void Registe(EnvironmentInterface& env)
+        {
+            Value::DictT string_dict = {
+                {U"builder", Value::New(Value::FunctionT(Builder))},
+            };
+            (void)env.AssignValue(U"string", Value::New(string_dict));
+        }
+    }
+}
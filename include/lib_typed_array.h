@@ -0,0 +1,202 @@
+#pragma once
+#include "environment_interface.h"
+#include "iterator.h"
+#include "pre_define.h"
+#include "typed_array.h"
+
+namespace LANG_NS
+{
+    namespace TypedArrayLib
+    {
+        static ValuePtrList Sum(ValuePtr arr, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            (void)params;
+            return {TypedArray::Sum(arr)};
+        }
+
+        static ValuePtrList Min(ValuePtr arr, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            (void)params;
+            return {TypedArray::Extreme<false>(arr)};
+        }
+
+        static ValuePtrList Max(ValuePtr arr, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            (void)params;
+            return {TypedArray::Extreme<true>(arr)};
+        }
+
+        static ValuePtrList Dot(ValuePtr arr, EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            if (params.size() != 1)
+            {
+                throw(Exception(U"TypedArray.Dot must be one params"));
+                return {};
+            }
+            return {TypedArray::Dot(arr, params[0])};
+        }
+
+        static ValuePtr GetFunc(ValuePtr arr, const StringT& key)
+        {
+            static const TMap<StringT, ValuePtrList(*)(ValuePtr, EnvironmentInterface&, const ValuePtrList&)> _funcs = {
+                {U"sum", Sum},
+                {U"min", Min},
+                {U"max", Max},
+                {U"dot", Dot},
+            };
+            auto iter = _funcs.find(key);
+            if (iter == _funcs.end())
+            {
+                return nullptr;
+            }
+            return Value::New(std::bind(iter->second, arr, std::placeholders::_1, std::placeholders::_2));
+        }
+
+        // int_array(size, fill), or int_array(x) for an array, typed array or range x, elements must be intergers
+        static ValuePtrList IntArray(EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            if (params.empty())
+            {
+                return {ValueData(Value::IntArrayT())};
+            }
+            auto& source = params[0];
+            if (source->GetType() == Value::EType::Int)
+            {
+                if (source->IntValue() < 0 || (params.size() >= 2 && params[1]->GetType() != Value::EType::Int))
+                {
+                    throw(Exception(U"int_array Invalid params"));
+                    return {};
+                }
+                auto fill = params.size() >= 2 ? params[1]->IntValue() : 0;
+                return {ValueData(Value::IntArrayT(static_cast<SizeT>(source->IntValue()), fill))};
+            }
+            if (source->GetType() == Value::EType::IntArray)
+            {
+                return {ValueData(source->IntArrayValue())};
+            }
+            if (source->GetType() == Value::EType::Range)
+            {
+                auto& range = source->RangeValue();
+                if (!range.interger)
+                {
+                    throw(Exception(U"int_array elements must be intergers"));
+                    return {};
+                }
+                Value::IntArrayT data;
+                data.reserve(Iterator::RangeSize(range));
+                for (ValuePtr state = nullptr, value = nullptr; Iterator::RangeNext(range, state, value);)
+                {
+                    data.push_back(value->IntValue());
+                }
+                return {ValueData(std::move(data))};
+            }
+            if (source->GetType() != Value::EType::Array)
+            {
+                throw(Exception(U"int_array Invalid params"));
+                return {};
+            }
+            auto& array_data = source->ArrayValue();
+            Value::IntArrayT data;
+            data.reserve(array_data.size());
+            for (auto iter = array_data.begin(); iter != array_data.end(); ++iter)
+            {
+                if (!*iter || (*iter)->GetType() != Value::EType::Int)
+                {
+                    throw(Exception(U"int_array elements must be intergers"));
+                    return {};
+                }
+                data.push_back((*iter)->IntValue());
+            }
+            return {ValueData(std::move(data))};
+        }
+
+        // float_array(size, fill), or float_array(x) for an array, typed array or range x, elements must be numbers
+        static ValuePtrList FloatArray(EnvironmentInterface& env, const ValuePtrList& params)
+        {
+            if (params.empty())
+            {
+                return {ValueData(Value::FloatArrayT())};
+            }
+            auto& source = params[0];
+            if (source->GetType() == Value::EType::Int)
+            {
+                FloatT fill = 0;
+                if (params.size() >= 2)
+                {
+                    if (params[1]->GetType() == Value::EType::Int)
+                    {
+                        fill = static_cast<FloatT>(params[1]->IntValue());
+                    }
+                    else if (params[1]->GetType() == Value::EType::Float)
+                    {
+                        fill = params[1]->FloatValue();
+                    }
+                    else
+                    {
+                        throw(Exception(U"float_array Invalid params"));
+                        return {};
+                    }
+                }
+                if (source->IntValue() < 0)
+                {
+                    throw(Exception(U"float_array Invalid params"));
+                    return {};
+                }
+                return {ValueData(Value::FloatArrayT(static_cast<SizeT>(source->IntValue()), fill))};
+            }
+            if (source->GetType() == Value::EType::IntArray)
+            {
+                auto& int_data = source->IntArrayValue();
+                return {ValueData(Value::FloatArrayT(int_data.begin(), int_data.end()))};
+            }
+            if (source->GetType() == Value::EType::FloatArray)
+            {
+                return {ValueData(source->FloatArrayValue())};
+            }
+            if (source->GetType() == Value::EType::Range)
+            {
+                auto& range = source->RangeValue();
+                Value::FloatArrayT data;
+                data.reserve(Iterator::RangeSize(range));
+                for (ValuePtr state = nullptr, value = nullptr; Iterator::RangeNext(range, state, value);)
+                {
+                    data.push_back(range.interger ? static_cast<FloatT>(value->IntValue()) : value->FloatValue());
+                }
+                return {ValueData(std::move(data))};
+            }
+            if (source->GetType() != Value::EType::Array)
+            {
+                throw(Exception(U"float_array Invalid params"));
+                return {};
+            }
+            auto& array_data = source->ArrayValue();
+            Value::FloatArrayT data;
+            data.reserve(array_data.size());
+            for (auto iter = array_data.begin(); iter != array_data.end(); ++iter)
+            {
+                if (*iter && (*iter)->GetType() == Value::EType::Int)
+                {
+                    data.push_back(static_cast<FloatT>((*iter)->IntValue()));
+                }
+                else if (*iter && (*iter)->GetType() == Value::EType::Float)
+                {
+                    data.push_back((*iter)->FloatValue());
+                }
+                else
+                {
+                    throw(Exception(U"float_array elements must be numbers"));
+                    return {};
+                }
+            }
+            return {ValueData(std::move(data))};
+        }
+
+        static void Registe(EnvironmentInterface& env)
+        {
+            env.RegisteFunctions({
+                {U"int_array", IntArray},
+                {U"float_array", FloatArray},
+            });
+        }
+    }
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <cmath>
 #include "pre_define.h"
 #include "token.h"
 
@@ -6,55 +7,105 @@ namespace LANG_NS
 {
     namespace Operator
     {
-        class Helper
-        {
-            Helper()
-                : OpPrioMap{
-                    {ETokenType::BitwiseNot, 2},
-                    {ETokenType::Not, 2},
-                    {ETokenType::Mul, 3},
-                    {ETokenType::Div, 3},
-                    {ETokenType::Mod, 3},
-                    {ETokenType::Add, 4},
-                    {ETokenType::Sub, 4},
-                    {ETokenType::Greater, 6},
-                    {ETokenType::GreaterEquel, 6},
-                    {ETokenType::Less, 6},
-                    {ETokenType::LessEquel, 6},
-                    {ETokenType::Equel, 7},
-                    {ETokenType::NotEquel, 7},
-                    {ETokenType::BitwiseAnd, 8},
-                    {ETokenType::Xor, 9},
-                    {ETokenType::BitwiseOr, 10},
-                    {ETokenType::And, 11},
-                    {ETokenType::Or, 12},
-                }
-            {}
-
-            TMap<ETokenType, SizeT> OpPrioMap;
+        // a lower priority binds tighter, 0 marks a token that is no binary operator
+        class BinaryInfo
+        {
+        public:
+            SizeT prio = 0;
+            bool right_assoc = false;
+        };
 
-            friend Option<SizeT> GetPrio(ETokenType token_type);
+        class Tables
+        {
+        public:
+            BinaryInfo binary[TokenTypeCount] = {};
+            // the binary operator of a compound assignment, Nil for other tokens
+            ETokenType compound[TokenTypeCount] = {};
         };
 
-        static Option<SizeT> GetPrio(ETokenType token_type)
+        static constexpr Tables MakeTables()
         {
-            static const Helper __helper;
-            auto iter = __helper.OpPrioMap.find(token_type);
-            if (iter == __helper.OpPrioMap.end())
+            Tables tables;
+            auto set = [&tables](ETokenType t, SizeT prio, bool right_assoc)
             {
-                return Option<SizeT>();
-            }
-            return Option<SizeT>(iter->second);
+                tables.binary[static_cast<SizeT>(t)].prio = prio;
+                tables.binary[static_cast<SizeT>(t)].right_assoc = right_assoc;
+            };
+            set(ETokenType::Pow, 2, true);
+            set(ETokenType::Mul, 3, false);
+            set(ETokenType::Div, 3, false);
+            set(ETokenType::Mod, 3, false);
+            set(ETokenType::Add, 4, false);
+            set(ETokenType::Sub, 4, false);
+            set(ETokenType::Greater, 6, false);
+            set(ETokenType::GreaterEquel, 6, false);
+            set(ETokenType::Less, 6, false);
+            set(ETokenType::LessEquel, 6, false);
+            set(ETokenType::Equel, 7, false);
+            set(ETokenType::NotEquel, 7, false);
+            set(ETokenType::BitwiseAnd, 8, false);
+            set(ETokenType::Xor, 9, false);
+            set(ETokenType::BitwiseOr, 10, false);
+            set(ETokenType::And, 11, false);
+            set(ETokenType::Or, 12, false);
+            // c ? a : b
+            set(ETokenType::Question, 13, true);
+
+            tables.compound[static_cast<SizeT>(ETokenType::AddAssign)] = ETokenType::Add;
+            tables.compound[static_cast<SizeT>(ETokenType::SubAssign)] = ETokenType::Sub;
+            tables.compound[static_cast<SizeT>(ETokenType::MulAssign)] = ETokenType::Mul;
+            tables.compound[static_cast<SizeT>(ETokenType::DivAssign)] = ETokenType::Div;
+            tables.compound[static_cast<SizeT>(ETokenType::ModAssign)] = ETokenType::Mod;
+            tables.compound[static_cast<SizeT>(ETokenType::PowAssign)] = ETokenType::Pow;
+            tables.compound[static_cast<SizeT>(ETokenType::BitwiseAndAssign)] = ETokenType::BitwiseAnd;
+            tables.compound[static_cast<SizeT>(ETokenType::BitwiseOrAssign)] = ETokenType::BitwiseOr;
+            tables.compound[static_cast<SizeT>(ETokenType::XorAssign)] = ETokenType::Xor;
+            return tables;
+        }
+
+        static constexpr Tables OperatorTables = MakeTables();
+
+        static constexpr const BinaryInfo& Binary(ETokenType token_type)
+        {
+            return OperatorTables.binary[static_cast<SizeT>(token_type)];
         }
 
-        static const SizeT MaxPrio()
+        static constexpr ETokenType CompoundBinary(ETokenType token_type)
         {
-            return 12;
+            return OperatorTables.compound[static_cast<SizeT>(token_type)];
         }
 
-        static const SizeT MinPrio()
+        // the loosest binary operator
+        static constexpr SizeT MaxPrio()
         {
-            return 3;
+            return 13;
+        }
+
+        // operands of unary operators take '**' and nothing looser, so -2 ** 2 is -(2 ** 2)
+        static constexpr SizeT UnaryOperandPrio()
+        {
+            return 2;
+        }
+
+        // an int raised to a negative power is a float
+        static bool IntPow(IntT base, IntT exp, IntT& result)
+        {
+            if (exp < 0)
+            {
+                return false;
+            }
+            IntT value = 1;
+            while (exp > 0)
+            {
+                if (exp & 1)
+                {
+                    value = static_cast<IntT>(static_cast<unsigned long long>(value) * static_cast<unsigned long long>(base));
+                }
+                base = static_cast<IntT>(static_cast<unsigned long long>(base) * static_cast<unsigned long long>(base));
+                exp >>= 1;
+            }
+            result = value;
+            return true;
         }
     }
 }
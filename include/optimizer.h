@@ -0,0 +1,452 @@
+#pragma once
+#include "bytecode.h"
+#include "executor.h"
+#include "pre_define.h"
+#include "syntax_tree.h"
+
+namespace LANG_NS
+{
+    // rewrites a chunk before compiling
+    //  - operators on literals are folded into one literal, with the same rules as the builtin operators
+    //  - if statements with a literal condition are replaced by the branch that runs
+    // define LANG_DEBUG_OPTIMIZER to print every rewrite
+    class Optimizer
+    {
+    public:
+        // folding needs the builtin operators, pass false once an operator function was replaced
+        // folded literals are allocated from the arena that owns the tree
+        Optimizer(Arena& arena, bool fold_operators)
+            : _arena(arena)
+            , _fold_operators(fold_operators)
+        {}
+
+        void Optimize(const SyntaxTree::NodePtr& node)
+        {
+            Assert(node->node_type == SyntaxTree::NodeType::Chunk);
+            if (_fold_operators && DefinesOperator(node))
+            {
+                // a script may bind its own __xxx to any name, leave every operator to the runtime
+                _fold_operators = false;
+            }
+            OptimizeStatement(static_cast<SyntaxTree::Chunk*>(node)->block);
+        }
+
+    private:
+        // longest string a fold may produce, longer ones are built when they run
+        static constexpr SizeT kMaxFoldedStringSize = 4096;
+
+        static bool IsLiteral(const SyntaxTree::NodePtr& node)
+        {
+            return node->node_type == SyntaxTree::NodeType::Terminator
+                && static_cast<SyntaxTree::Terminator*>(node)->token->GetType() != ETokenType::Id;
+        }
+
+        // any name of the chunk that looks like an operator function
+        static bool DefinesOperator(const SyntaxTree::NodePtr& node)
+        {
+            if (!node)
+            {
+                return false;
+            }
+            switch (node->node_type)
+            {
+            case SyntaxTree::NodeType::Chunk:
+                return DefinesOperator(static_cast<SyntaxTree::Chunk*>(node)->block);
+            case SyntaxTree::NodeType::Block:
+            {
+                auto& statements = static_cast<SyntaxTree::Block*>(node)->statements;
+                for (auto iter = statements.begin(); iter != statements.end(); ++iter)
+                {
+                    if (DefinesOperator(*iter))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            case SyntaxTree::NodeType::FunctionStatement:
+            {
+                auto statement = static_cast<SyntaxTree::FunctionStatement*>(node);
+                return DefinesOperator(statement->var_name_list) || DefinesOperator(statement->block);
+            }
+            case SyntaxTree::NodeType::ReturnStatement:
+                return DefinesOperator(static_cast<SyntaxTree::ReturnStatement*>(node)->exprs);
+            case SyntaxTree::NodeType::CallStatement:
+            {
+                auto statement = static_cast<SyntaxTree::CallStatement*>(node);
+                return DefinesOperator(statement->func) || DefinesOperator(statement->expr_list);
+            }
+            case SyntaxTree::NodeType::VarNameListStatement:
+            {
+                auto statement = static_cast<SyntaxTree::VarNameListStatement*>(node);
+                return DefinesOperator(statement->name_list) || DefinesOperator(statement->expr_list);
+            }
+            case SyntaxTree::NodeType::AssignmentStatement:
+            {
+                auto statement = static_cast<SyntaxTree::AssignmentStatement*>(node);
+                return DefinesOperator(statement->var_list) || DefinesOperator(statement->expr_list);
+            }
+            case SyntaxTree::NodeType::IfStatement:
+            {
+                auto statement = static_cast<SyntaxTree::IfStatement*>(node);
+                return DefinesOperator(statement->expr)
+                    || DefinesOperator(statement->true_branch)
+                    || DefinesOperator(statement->false_branch);
+            }
+            case SyntaxTree::NodeType::ElseStatement:
+                return DefinesOperator(static_cast<SyntaxTree::ElseStatement*>(node)->block);
+            case SyntaxTree::NodeType::WhileStatement:
+            {
+                auto statement = static_cast<SyntaxTree::WhileStatement*>(node);
+                return DefinesOperator(statement->expr) || DefinesOperator(statement->block);
+            }
+            case SyntaxTree::NodeType::ForStatement:
+            {
+                auto statement = static_cast<SyntaxTree::ForStatement*>(node);
+                return DefinesOperator(statement->var_name_list)
+                    || DefinesOperator(statement->expr)
+                    || DefinesOperator(statement->block);
+            }
+            case SyntaxTree::NodeType::ArrayStatement:
+                return DefinesOperator(static_cast<SyntaxTree::ArrayStatement*>(node)->expr_list);
+            case SyntaxTree::NodeType::MapStatement:
+            {
+                auto statement = static_cast<SyntaxTree::MapStatement*>(node);
+                return DefinesOperator(statement->key_expr_list) || DefinesOperator(statement->val_expr_list);
+            }
+            case SyntaxTree::NodeType::VarList:
+            {
+                auto& vars = static_cast<SyntaxTree::VarList*>(node)->vars;
+                for (auto iter = vars.begin(); iter != vars.end(); ++iter)
+                {
+                    if (DefinesOperator(*iter))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            case SyntaxTree::NodeType::NameList:
+            {
+                auto& names = static_cast<SyntaxTree::NameList*>(node)->names;
+                for (auto iter = names.begin(); iter != names.end(); ++iter)
+                {
+                    if (IsOperatorName((*iter)->StringValue()))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            case SyntaxTree::NodeType::ExpressionList:
+            {
+                auto& exprs = static_cast<SyntaxTree::ExpressionList*>(node)->exprs;
+                for (auto iter = exprs.begin(); iter != exprs.end(); ++iter)
+                {
+                    if (DefinesOperator(*iter))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            case SyntaxTree::NodeType::BinaryExpression:
+            {
+                auto expr = static_cast<SyntaxTree::BinaryExpression*>(node);
+                return DefinesOperator(expr->left) || DefinesOperator(expr->right);
+            }
+            case SyntaxTree::NodeType::UnaryExpression:
+                return DefinesOperator(static_cast<SyntaxTree::UnaryExpression*>(node)->expr);
+            case SyntaxTree::NodeType::ConditionalExpression:
+            {
+                auto expr = static_cast<SyntaxTree::ConditionalExpression*>(node);
+                return DefinesOperator(expr->expr) || DefinesOperator(expr->true_expr) || DefinesOperator(expr->false_expr);
+            }
+            case SyntaxTree::NodeType::VarExpression:
+            {
+                auto expr = static_cast<SyntaxTree::VarExpression*>(node);
+                return DefinesOperator(expr->expr) || DefinesOperator(expr->key);
+            }
+            case SyntaxTree::NodeType::Terminator:
+            {
+                auto& token = static_cast<SyntaxTree::Terminator*>(node)->token;
+                // assigned names are String tokens
+                return (token->GetType() == ETokenType::Id || token->GetType() == ETokenType::String)
+                    && IsOperatorName(token->StringValue());
+            }
+            default:
+                return false;
+            }
+        }
+
+        static bool IsOperatorName(const StringT& name)
+        {
+            return name.size() > 2 && name[0] == U'_' && name[1] == U'_';
+        }
+
+        // statements of a block, dropping and splicing if statements with a literal condition
+        void OptimizeBlockStatements(const SyntaxTree::NodePtr& node)
+        {
+            auto block = static_cast<SyntaxTree::Block*>(node);
+            SyntaxTree::NodePtrList statements;
+            statements.reserve(block->statements.size());
+            for (auto iter = block->statements.begin(); iter != block->statements.end(); ++iter)
+            {
+                auto statement = *iter;
+                OptimizeStatement(statement);
+                if (statement->node_type == SyntaxTree::NodeType::IfStatement)
+                {
+                    statement = TakenBranch(statement);
+                    if (!statement)
+                    {
+                        continue;
+                    }
+                }
+                statements.push_back(statement);
+            }
+            block->statements.swap(statements);
+        }
+
+        // the statement an if statement runs when its condition is a literal, nullptr for none
+        SyntaxTree::NodePtr TakenBranch(const SyntaxTree::NodePtr& node)
+        {
+            auto statement = static_cast<SyntaxTree::IfStatement*>(node);
+            if (!IsLiteral(statement->expr))
+            {
+                return node;
+            }
+            auto& token = static_cast<SyntaxTree::Terminator*>(statement->expr)->token;
+            auto condition = Value::New(token)->BoolValue();
+            Report(token, condition ? U"if branch taken" : U"if branch removed");
+            if (condition)
+            {
+                return statement->true_branch;
+            }
+            if (!statement->false_branch)
+            {
+                return nullptr;
+            }
+            if (statement->false_branch->node_type == SyntaxTree::NodeType::IfStatement)
+            {
+                return TakenBranch(statement->false_branch);
+            }
+            return static_cast<SyntaxTree::ElseStatement*>(statement->false_branch)->block;
+        }
+
+        void OptimizeStatement(SyntaxTree::NodePtr& node)
+        {
+            switch (node->node_type)
+            {
+            case SyntaxTree::NodeType::Block:
+                OptimizeBlockStatements(node);
+                break;
+            case SyntaxTree::NodeType::VarNameListStatement:
+                OptimizeExpr(static_cast<SyntaxTree::VarNameListStatement*>(node)->expr_list);
+                break;
+            case SyntaxTree::NodeType::AssignmentStatement:
+            {
+                auto statement = static_cast<SyntaxTree::AssignmentStatement*>(node);
+                auto& vars = static_cast<SyntaxTree::VarList*>(statement->var_list)->vars;
+                for (auto iter = vars.begin(); iter != vars.end(); ++iter)
+                {
+                    auto var = static_cast<SyntaxTree::VarExpression*>(*iter);
+                    if (var->expr)
+                    {
+                        OptimizeExpr(var->key);
+                        OptimizeExpr(var->expr);
+                    }
+                }
+                OptimizeExpr(statement->expr_list);
+                break;
+            }
+            case SyntaxTree::NodeType::WhileStatement:
+            {
+                auto statement = static_cast<SyntaxTree::WhileStatement*>(node);
+                OptimizeExpr(statement->expr);
+                OptimizeStatement(statement->block);
+                break;
+            }
+            case SyntaxTree::NodeType::ForStatement:
+            {
+                auto statement = static_cast<SyntaxTree::ForStatement*>(node);
+                OptimizeExpr(statement->expr);
+                OptimizeStatement(statement->block);
+                break;
+            }
+            case SyntaxTree::NodeType::BreakStatement:
+            case SyntaxTree::NodeType::ContinueStatement:
+                break;
+            case SyntaxTree::NodeType::ReturnStatement:
+                OptimizeExpr(static_cast<SyntaxTree::ReturnStatement*>(node)->exprs);
+                break;
+            default:
+                OptimizeExpr(node);
+                break;
+            }
+        }
+
+        // node is replaced by its folded literal
+        void OptimizeExpr(SyntaxTree::NodePtr& node)
+        {
+            if (!node)
+            {
+                return;
+            }
+            switch (node->node_type)
+            {
+            case SyntaxTree::NodeType::BinaryExpression:
+            {
+                auto expr = static_cast<SyntaxTree::BinaryExpression*>(node);
+                OptimizeExpr(expr->left);
+                OptimizeExpr(expr->right);
+                auto op = Bytecode::BinaryOpCode(expr->op->GetType());
+                if (!_fold_operators || !op || !IsLiteral(expr->left) || !IsLiteral(expr->right))
+                {
+                    break;
+                }
+                ValuePtr result;
+                auto left = Value::New(static_cast<SyntaxTree::Terminator*>(expr->left)->token);
+                auto right = Value::New(static_cast<SyntaxTree::Terminator*>(expr->right)->token);
+                if (Executor::FastBinary(*op, left, right, result))
+                {
+                    Fold(node, expr->op, result);
+                }
+                break;
+            }
+            case SyntaxTree::NodeType::UnaryExpression:
+            {
+                auto expr = static_cast<SyntaxTree::UnaryExpression*>(node);
+                OptimizeExpr(expr->expr);
+                auto op = Bytecode::UnaryOpCode(expr->op->GetType());
+                if (!_fold_operators || !op || !IsLiteral(expr->expr))
+                {
+                    break;
+                }
+                ValuePtr result;
+                auto val = Value::New(static_cast<SyntaxTree::Terminator*>(expr->expr)->token);
+                if (Executor::FastUnary(*op, val, result))
+                {
+                    Fold(node, expr->op, result);
+                }
+                break;
+            }
+            case SyntaxTree::NodeType::ConditionalExpression:
+            {
+                // a literal condition leaves only the branch that runs
+                auto expr = static_cast<SyntaxTree::ConditionalExpression*>(node);
+                OptimizeExpr(expr->expr);
+                OptimizeExpr(expr->true_expr);
+                OptimizeExpr(expr->false_expr);
+                if (IsLiteral(expr->expr))
+                {
+                    auto& token = static_cast<SyntaxTree::Terminator*>(expr->expr)->token;
+                    auto condition = Value::New(token)->BoolValue();
+                    Report(token, condition ? U"true branch taken" : U"false branch taken");
+                    node = condition ? expr->true_expr : expr->false_expr;
+                }
+                break;
+            }
+            case SyntaxTree::NodeType::VarExpression:
+            {
+                auto expr = static_cast<SyntaxTree::VarExpression*>(node);
+                OptimizeExpr(expr->expr);
+                OptimizeExpr(expr->key);
+                break;
+            }
+            case SyntaxTree::NodeType::FunctionStatement:
+                OptimizeStatement(static_cast<SyntaxTree::FunctionStatement*>(node)->block);
+                break;
+            case SyntaxTree::NodeType::CallStatement:
+            {
+                auto statement = static_cast<SyntaxTree::CallStatement*>(node);
+                OptimizeExpr(statement->func);
+                OptimizeExpr(statement->expr_list);
+                break;
+            }
+            case SyntaxTree::NodeType::IfStatement:
+            {
+                // an if expression keeps its shape, its value comes from the branch that runs
+                auto statement = static_cast<SyntaxTree::IfStatement*>(node);
+                OptimizeExpr(statement->expr);
+                OptimizeStatement(statement->true_branch);
+                OptimizeExpr(statement->false_branch);
+                break;
+            }
+            case SyntaxTree::NodeType::ElseStatement:
+                OptimizeStatement(static_cast<SyntaxTree::ElseStatement*>(node)->block);
+                break;
+            case SyntaxTree::NodeType::ArrayStatement:
+                OptimizeExpr(static_cast<SyntaxTree::ArrayStatement*>(node)->expr_list);
+                break;
+            case SyntaxTree::NodeType::MapStatement:
+            {
+                auto statement = static_cast<SyntaxTree::MapStatement*>(node);
+                OptimizeExpr(statement->key_expr_list);
+                OptimizeExpr(statement->val_expr_list);
+                break;
+            }
+            case SyntaxTree::NodeType::ExpressionList:
+            {
+                auto& exprs = static_cast<SyntaxTree::ExpressionList*>(node)->exprs;
+                for (auto iter = exprs.begin(); iter != exprs.end(); ++iter)
+                {
+                    OptimizeExpr(*iter);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        void Fold(SyntaxTree::NodePtr& node, const SyntaxTree::TokenPtr& op, const ValuePtr& result)
+        {
+            auto line = op->GetLine();
+            auto column = op->GetColumn();
+            SyntaxTree::TokenPtr token = nullptr;
+            switch (result->GetType())
+            {
+            case Value::EType::Nil:
+                token = TokenT::New(_arena, line, column);
+                break;
+            case Value::EType::Bool:
+                token = TokenT::New(_arena, result->BoolValue(), line, column);
+                break;
+            case Value::EType::Int:
+                token = TokenT::New(_arena, result->IntValue(), line, column);
+                break;
+            case Value::EType::Float:
+                token = TokenT::New(_arena, result->FloatValue(), line, column);
+                break;
+            case Value::EType::String:
+                if (result->StringSize() > kMaxFoldedStringSize)
+                {
+                    return;
+                }
+                token = TokenT::New(_arena, result->StringValue(), line, column);
+                break;
+            default:
+                return;
+            }
+            auto terminator = _arena.New<SyntaxTree::Terminator>();
+            terminator->token = token;
+            node = terminator;
+            Report(token, U"folded");
+        }
+
+        void Report(const SyntaxTree::TokenPtr& token, const StringT& what)
+        {
+#ifdef LANG_DEBUG_OPTIMIZER
+            std::cout << "[optimizer] " << token->GetLine() << ":" << token->GetColumn()
+                << " " << what << " " << token->ToString() << std::endl;
+#else
+            (void)token;
+            (void)what;
+#endif
+        }
+
+    private:
+        Arena& _arena;
+        bool _fold_operators;
+    };
+}
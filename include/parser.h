@@ -5,19 +5,49 @@
 
 namespace LANG_NS
 {
+	// a syntax error found while parsing, at the token or character it was found at
+	class Diagnostic
+	{
+	public:
+		SizeT line;
+		SizeT column;
+		StringT message;
+	};
+
 	class Parser
 	{
 	public:
-		Parser(const SharedPtr<Scanner> scanner)
+		// recover keeps parsing after an error and collects every error in Diagnostics()
+		//  - a bad statement is dropped and parsing goes on from the next statement boundary
+		//  - Parse() never throws, the tree it returns is only good for checking
+		Parser(const SharedPtr<Scanner> scanner, bool recover = false)
 			: _scanner(scanner)
+			, _arena(_scanner->GetArena())
 			, _module_name(_scanner ? _scanner->ModuleName() : U"<unknown>")
+			, _recover(recover)
 		{
 
 		}
 
 		SyntaxTree::NodePtr Parse()
 		{
-			return ParseChunk();
+			if (!_recover)
+			{
+				return ParseChunk();
+			}
+			try
+			{
+				return ParseChunk();
+			}
+			catch (const Exception& e)
+			{
+				// the input could not be skipped, keep what was found so far
+				if (_diagnostics.empty() || _diagnostics.back().message != e.Info())
+				{
+					_diagnostics.push_back(Diagnostic{ _error_line, _error_column, e.Info() });
+				}
+			}
+			return nullptr;
 		}
         
         const StringT ModuleName() const
@@ -25,65 +55,209 @@ namespace LANG_NS
             return _module_name;
         }
 
+		const TVector<Diagnostic>& Diagnostics() const
+		{
+			return _diagnostics;
+		}
+
+		// the last error was hitting the end of input, more input could complete it
+		bool EndedEarly() const
+		{
+			return _ended_early;
+		}
+
 	private:
-		SyntaxTree::NodePtr Error(const StringT& err_info) const
+		SyntaxTree::NodePtr Error(const StringT& err_info)
 		{
+			// an error at the first token of the input has only looked ahead
+			auto token = _current_token ? _current_token : _look_ahead_token;
 			StringT err_msg(err_info);
 			err_msg += U" near token '";
-			err_msg += _current_token->ToString();
+			err_msg += token->ToString();
 			err_msg += U"' in module ";
 			err_msg += _module_name;
 			err_msg += U" line ";
-			err_msg += ToString(_current_token->GetLine());
+			err_msg += ToString(token->GetLine());
 			err_msg += U" column ";
-			err_msg += ToString(_current_token->GetColumn());
+			err_msg += ToString(token->GetColumn());
+			_error_line = token->GetLine();
+			_error_column = token->GetColumn();
+			_scan_failed = false;
+			_ended_early = token->GetType() == ETokenType::Eof
+				|| (_look_ahead_token && _look_ahead_token->GetType() == ETokenType::Eof);
 			throw(Exception(err_msg));
-			return SyntaxTree::NodePtr();
+			return nullptr;
 		}
 
-		SharedPtr<TokenT> NextToken()
+		TokenT* Scan()
+		{
+			try
+			{
+				return _scanner->Scan();
+			}
+			catch (const Exception&)
+			{
+				_error_line = _scanner->GetLine();
+				_error_column = _scanner->GetColumn();
+				_scan_failed = true;
+				_ended_early = false;
+				throw;
+			}
+		}
+
+		TokenT* NextToken()
 		{
 			if (_look_ahead_token)
 			{
 				_current_token = _look_ahead_token;
-				_look_ahead_token.reset();
+				_look_ahead_token = nullptr;
 			}
 			else
 			{
-				_current_token = _scanner->Scan();
+				_current_token = Scan();
 			}
+			++_consumed;
 			return _current_token;
 		}
 
-		SharedPtr<TokenT> LookAheadToken()
+		TokenT* LookAheadToken()
 		{
 			if (!_look_ahead_token)
 			{
-				_look_ahead_token = _scanner->Scan();
+				_look_ahead_token = Scan();
 			}
 			return _look_ahead_token;
 		}
 
+		// records the error being handled and skips to where the next statement may start
+		//  - a new line, a statement keyword, the '}' closing the block or the end of input
+		//  - braces opened while skipping are skipped up to their '}'
+		//  - at least one token is dropped when the failed statement consumed nothing
+		void Recover(const Exception& e, SizeT consumed)
+		{
+			auto line = _error_line;
+			_diagnostics.push_back(Diagnostic{ _error_line, _error_column, e.Info() });
+			if (_scan_failed)
+			{
+				SkipCharacter();
+			}
+			auto must_drop = _consumed == consumed;
+			SizeT depth = _current_token && _current_token->GetType() == ETokenType::LeftBrace ? 1 : 0;
+			while (true)
+			{
+				try
+				{
+					auto token = LookAheadToken();
+					auto type = token->GetType();
+					if (type == ETokenType::Eof)
+					{
+						return;
+					}
+					if (!must_drop && depth == 0 && (type == ETokenType::RightBrace || token->GetLine() > line || StartsStatement(type)))
+					{
+						return;
+					}
+					if (type == ETokenType::LeftBrace)
+					{
+						++depth;
+					}
+					else if (type == ETokenType::RightBrace && depth > 0)
+					{
+						--depth;
+					}
+					(void)NextToken();
+					must_drop = false;
+				}
+				catch (const Exception& scan_error)
+				{
+					_diagnostics.push_back(Diagnostic{ _error_line, _error_column, scan_error.Info() });
+					SkipCharacter();
+				}
+			}
+		}
+
+		void SkipCharacter()
+		{
+			try
+			{
+				_scanner->Skip();
+			}
+			catch (const Exception&)
+			{
+				_error_line = _scanner->GetLine();
+				_error_column = _scanner->GetColumn();
+				_gave_up = true;
+				throw;
+			}
+		}
+
+		static bool StartsStatement(ETokenType type)
+		{
+			switch (type)
+			{
+			case ETokenType::Var:
+			case ETokenType::If:
+			case ETokenType::While:
+			case ETokenType::Break:
+			case ETokenType::Continue:
+			case ETokenType::For:
+			case ETokenType::Function:
+			case ETokenType::Return:
+				return true;
+			default:
+				return false;
+			}
+		}
+
 		SyntaxTree::NodePtr ParseChunk()
 		{
-			auto chunk = MakeShared<SyntaxTree::Chunk>();
+			auto chunk = _arena.New<SyntaxTree::Chunk>();
 			chunk->block = ParseBlock();
-			if (NextToken()->GetType() != ETokenType::Eof)
+			while (NextToken()->GetType() != ETokenType::Eof)
 			{
-				return Error(U"Except <eof>");
+				auto consumed = _consumed - 1;
+				try
+				{
+					return Error(U"Except <eof>");
+				}
+				catch (const Exception& e)
+				{
+					if (!_recover || _gave_up)
+					{
+						throw;
+					}
+					// a stray '}', parse on after it
+					Recover(e, consumed);
+					auto rest = static_cast<SyntaxTree::Block*>(ParseBlock());
+					auto block = static_cast<SyntaxTree::Block*>(chunk->block);
+					block->statements.insert(block->statements.end(), rest->statements.begin(), rest->statements.end());
+				}
 			}
 			return chunk;
 		}
 
 		SyntaxTree::NodePtr ParseBlock()
 		{
-			auto block = MakeShared<SyntaxTree::Block>();
+			auto block = _arena.New<SyntaxTree::Block>();
 			while (
 				LookAheadToken()->GetType() != ETokenType::Eof
 				&& LookAheadToken()->GetType() != ETokenType::RightBrace
 			)
 			{
-				auto statement = ParseStatement();
+				SyntaxTree::NodePtr statement = nullptr;
+				auto consumed = _consumed;
+				try
+				{
+					statement = ParseStatement();
+				}
+				catch (const Exception& e)
+				{
+					if (!_recover || _gave_up)
+					{
+						throw;
+					}
+					Recover(e, consumed);
+				}
 				if (statement)
 				{
 					block->statements.push_back(statement);
@@ -111,6 +285,10 @@ namespace LANG_NS
 			{
 				return ParseBreakStatement();
 			}
+			else if (look_ahead_token->GetType() == ETokenType::Continue)
+			{
+				return ParseContinueStatement();
+			}
 			else if (look_ahead_token->GetType() == ETokenType::For)
 			{
 				return ParseForStatement();
@@ -137,13 +315,13 @@ namespace LANG_NS
 			{
 				return ParseOtherStatement();
 			}
-			return SyntaxTree::NodePtr();
+			return nullptr;
 		}
 
 		SyntaxTree::NodePtr ParseVarNameListStatement()
 		{
 			Assert(NextToken()->GetType() == ETokenType::Var);
-			auto var_define_statement = MakeShared<SyntaxTree::VarNameListStatement>();
+			auto var_define_statement = _arena.New<SyntaxTree::VarNameListStatement>();
 			if (LookAheadToken()->GetType() != ETokenType::Id)
 			{
 				return Error(U"Unexcept Token after 'var'");
@@ -160,7 +338,7 @@ namespace LANG_NS
 		SyntaxTree::NodePtr ParseIfStatement()
 		{
 			Assert(NextToken()->GetType() == ETokenType::If);
-			auto if_statement = MakeShared<SyntaxTree::IfStatement>();
+			auto if_statement = _arena.New<SyntaxTree::IfStatement>();
 			if (NextToken()->GetType() != ETokenType::LeftParen)
 			{
 				return Error(U"Except '('");
@@ -201,7 +379,7 @@ namespace LANG_NS
 		SyntaxTree::NodePtr ParseElseStatement()
 		{
 			Assert(_current_token->GetType() == ETokenType::Else);
-			auto else_statement = MakeShared<SyntaxTree::ElseStatement>();
+			auto else_statement = _arena.New<SyntaxTree::ElseStatement>();
 			if (NextToken()->GetType() != ETokenType::LeftBrace)
 			{
 				return Error(U"Except '{'");
@@ -217,7 +395,7 @@ namespace LANG_NS
 		SyntaxTree::NodePtr ParseWhileStatement()
 		{
 			Assert(NextToken()->GetType() == ETokenType::While);
-			auto while_statement = MakeShared<SyntaxTree::WhileStatement>();
+			auto while_statement = _arena.New<SyntaxTree::WhileStatement>();
 			if (NextToken()->GetType() != ETokenType::LeftParen)
 			{
 				return Error(U"Except '('");
@@ -249,13 +427,23 @@ namespace LANG_NS
 			{
 				return Error(U"Unexcept 'break'");
 			}
-			return MakeShared<SyntaxTree::BreakStatement>();
+			return _arena.New<SyntaxTree::BreakStatement>();
+		}
+
+		SyntaxTree::NodePtr ParseContinueStatement()
+		{
+			Assert(NextToken()->GetType() == ETokenType::Continue);
+			if (!_in_loop)
+			{
+				return Error(U"Unexcept 'continue'");
+			}
+			return _arena.New<SyntaxTree::ContinueStatement>();
 		}
 
 		SyntaxTree::NodePtr ParseForStatement()
 		{
 			Assert(NextToken()->GetType() == ETokenType::For);
-			auto for_statement = MakeShared<SyntaxTree::ForStatement>();
+			auto for_statement = _arena.New<SyntaxTree::ForStatement>();
 			if (NextToken()->GetType() != ETokenType::LeftParen)
 			{
 				return Error(U"Except '('");
@@ -288,7 +476,7 @@ namespace LANG_NS
 		SyntaxTree::NodePtr ParseArrayStatement()
 		{
 			Assert(NextToken()->GetType() == ETokenType::LeftSquareBrace);
-			auto array_statement = MakeShared<SyntaxTree::ArrayStatement>();
+			auto array_statement = _arena.New<SyntaxTree::ArrayStatement>();
 			if (LookAheadToken()->GetType() != ETokenType::RightSquareBrace)
 			{
 				array_statement->expr_list = ParseExpressionList();
@@ -303,9 +491,9 @@ namespace LANG_NS
 		SyntaxTree::NodePtr ParseMapStatement()
 		{
 			Assert(NextToken()->GetType() == ETokenType::LeftBrace);
-			auto map_statement = MakeShared<SyntaxTree::MapStatement>();
-			auto key_expr_list = MakeShared<SyntaxTree::ExpressionList>();
-			auto val_expr_list = MakeShared<SyntaxTree::ExpressionList>();
+			auto map_statement = _arena.New<SyntaxTree::MapStatement>();
+			auto key_expr_list = _arena.New<SyntaxTree::ExpressionList>();
+			auto val_expr_list = _arena.New<SyntaxTree::ExpressionList>();
 			while (
 				LookAheadToken()->GetType() == ETokenType::LeftSquareBrace
 				|| LookAheadToken()->GetType() == ETokenType::Id
@@ -323,8 +511,8 @@ namespace LANG_NS
 				else if (LookAheadToken()->GetType() == ETokenType::Id)
 				{
 					(void)NextToken();
-					auto terminator = MakeShared<SyntaxTree::Terminator>();
-					terminator->token = TokenT::New(_current_token->StringValue(), _current_token->GetLine(), _current_token->GetColumn());
+					auto terminator = _arena.New<SyntaxTree::Terminator>();
+					terminator->token = TokenT::New(_arena, _current_token->StringValue(), _current_token->GetLine(), _current_token->GetColumn());
 					key_expr_list->exprs.push_back(terminator);
 				}
 
@@ -351,10 +539,10 @@ namespace LANG_NS
 		SyntaxTree::NodePtr ParseFunctionStatement()
 		{
 			Assert(NextToken()->GetType() == ETokenType::Function);
-			auto function_statement = MakeShared<SyntaxTree::FunctionStatement>();
+			auto function_statement = _arena.New<SyntaxTree::FunctionStatement>();
 			if (LookAheadToken()->GetType() == ETokenType::Id)
 			{
-				function_statement->name = NextToken()->Clone();
+				function_statement->name = NextToken();
 			}
 			if (NextToken()->GetType() != ETokenType::LeftParen)
 			{
@@ -380,7 +568,7 @@ namespace LANG_NS
 		SyntaxTree::NodePtr ParseReturnStatement()
 		{
 			Assert(NextToken()->GetType() == ETokenType::Return);
-			auto return_statement = MakeShared<SyntaxTree::ReturnStatement>();
+			auto return_statement = _arena.New<SyntaxTree::ReturnStatement>();
 			return_statement->exprs = ParseExpressionList();
 			return return_statement;
 		}
@@ -388,7 +576,7 @@ namespace LANG_NS
 		SyntaxTree::NodePtr ParseCallStatement(SyntaxTree::NodePtr func)
 		{
 			Assert(NextToken()->GetType() == ETokenType::LeftParen);
-			auto call_statement = MakeShared<SyntaxTree::CallStatement>();
+			auto call_statement = _arena.New<SyntaxTree::CallStatement>();
 			call_statement->func = func;
 			if (LookAheadToken()->GetType() != ETokenType::RightParen)
 			{
@@ -396,7 +584,7 @@ namespace LANG_NS
 			}
 			else
 			{
-				call_statement->expr_list = MakeShared<SyntaxTree::ExpressionList>();
+				call_statement->expr_list = _arena.New<SyntaxTree::ExpressionList>();
 			}
 			
 			if (NextToken()->GetType() != ETokenType::RightParen)
@@ -408,9 +596,9 @@ namespace LANG_NS
 
 		SyntaxTree::NodePtr ParseAssignmentStatement(SyntaxTree::NodePtr first_var)
 		{
-			auto assignment_statement = MakeShared<SyntaxTree::AssignmentStatement>();
-			auto var_list = MakeShared<SyntaxTree::VarList>();
-			auto prefix_expr = SyntaxTree::Node2VarExpression(first_var);
+			auto assignment_statement = _arena.New<SyntaxTree::AssignmentStatement>();
+			auto var_list = _arena.New<SyntaxTree::VarList>();
+			auto prefix_expr = SyntaxTree::Node2VarExpression(_arena, first_var);
 			if (!prefix_expr)
 			{
 				return Error(U"Not a left value");
@@ -419,7 +607,7 @@ namespace LANG_NS
 			while (LookAheadToken()->GetType() == ETokenType::Comma)
 			{
 				(void)NextToken();
-				prefix_expr = SyntaxTree::Node2VarExpression(ParseExpression());
+				prefix_expr = SyntaxTree::Node2VarExpression(_arena, ParseExpression());
 				if (!prefix_expr)
 				{
 					return Error(U"Not a left value");
@@ -450,12 +638,38 @@ namespace LANG_NS
 			{
 				return ParseAssignmentStatement(expr);
 			}
+			auto op = Operator::CompoundBinary(LookAheadToken()->GetType());
+			if (op != ETokenType::Nil)
+			{
+				return ParseCompoundAssignmentStatement(expr, op);
+			}
 			return expr;
 		}
 
+		// a op= b is parsed as a = a op b, the compiler evaluates the container and key of a member target once
+		SyntaxTree::NodePtr ParseCompoundAssignmentStatement(SyntaxTree::NodePtr var, ETokenType op)
+		{
+			auto prefix_expr = SyntaxTree::Node2VarExpression(_arena, var);
+			if (!prefix_expr)
+			{
+				return Error(U"Not a left value");
+			}
+			auto assign = NextToken();
+			auto assignment_statement = _arena.New<SyntaxTree::AssignmentStatement>();
+			auto var_list = _arena.New<SyntaxTree::VarList>();
+			var_list->vars.push_back(prefix_expr);
+			auto expr_list = _arena.New<SyntaxTree::ExpressionList>();
+			auto binary_op = TokenT::New(_arena, op, assign->GetLine(), assign->GetColumn());
+			expr_list->exprs.push_back(MakeBinaryExpr(binary_op, var, ParseExpression()));
+			assignment_statement->var_list = var_list;
+			assignment_statement->expr_list = expr_list;
+			assignment_statement->compound = true;
+			return assignment_statement;
+		}
+
 		SyntaxTree::NodePtr ParseNameList()
 		{
-			auto name_list = MakeShared<SyntaxTree::NameList>();
+			auto name_list = _arena.New<SyntaxTree::NameList>();
 			if (LookAheadToken()->GetType() == ETokenType::RightParen)
 			{
 				return name_list;
@@ -464,7 +678,7 @@ namespace LANG_NS
 			{
 				return Error(U"Except a <id>");
 			}
-			name_list->names.push_back(_current_token->Clone());
+			name_list->names.push_back(_current_token);
 			while (LookAheadToken()->GetType() == ETokenType::Comma)
 			{
 				(void)NextToken();
@@ -472,14 +686,14 @@ namespace LANG_NS
 				{
 					return Error(U"Except a <id> after ','");
 				}
-				name_list->names.push_back(_current_token->Clone());
+				name_list->names.push_back(_current_token);
 			}
 			return name_list;
 		}
 
 		SyntaxTree::NodePtr ParseExpressionList()
 		{
-			auto expr_list = MakeShared<SyntaxTree::ExpressionList>();
+			auto expr_list = _arena.New<SyntaxTree::ExpressionList>();
 			while (true)
 			{
 				expr_list->exprs.push_back(ParseExpression());
@@ -494,10 +708,11 @@ namespace LANG_NS
 
 		SyntaxTree::NodePtr ParseExpression()
 		{
-			return ParseExprImpl();
+			return ParseExprImpl(Operator::MaxPrio());
 		}
 
-		SyntaxTree::NodePtr ParseExprImpl()
+		// binary operators looser than max_prio are left to the caller
+		SyntaxTree::NodePtr ParseExprImpl(SizeT max_prio)
 		{
 			if (LookAheadToken()->GetType() == ETokenType::If)
 			{
@@ -515,54 +730,41 @@ namespace LANG_NS
 			{
 				return ParseMapStatement();
 			}
-			SyntaxTree::NodePtrList expr_list;
-			SyntaxTree::TokenPtrList op_list;
-			do
-			{
-				SyntaxTree::NodePtr expr;
-				if (LookAheadToken()->GetType() == ETokenType::LeftParen)
-				{
-					(void)NextToken();
-					expr = ParseExprImpl();
-					if (NextToken()->GetType() != ETokenType::RightParen)
-					{
-						return Error(U"Except ')'");
-					}
-				}
-				else
-				{
-					expr = ParseSingleExpr();
-				}
-				expr_list.push_back(expr);
-				if (!Operator::GetPrio(LookAheadToken()->GetType()))
-				{
-					break;
-				}
-				op_list.push_back(NextToken()->Clone());
-			} while (true);
-			for (SizeT i = Operator::MinPrio(); i <= Operator::MaxPrio(); ++ i)
+			return ParseBinaryExpr(max_prio);
+		}
+
+		// precedence climbing, every operator is read once
+		SyntaxTree::NodePtr ParseBinaryExpr(SizeT max_prio)
+		{
+			auto expr = ParseSingleExpr();
+			while (true)
 			{
-				Assert(expr_list.size() == op_list.size() + 1);
-				if (op_list.empty())
+				auto& info = Operator::Binary(LookAheadToken()->GetType());
+				if (info.prio == 0 || info.prio > max_prio)
 				{
 					break;
 				}
-				for (SizeT j = 0; j < op_list.size();)
+				auto op = NextToken();
+				if (op->GetType() == ETokenType::Question)
 				{
-					Assert(expr_list.size() == op_list.size() + 1);
-					if (*Operator::GetPrio(op_list[j]->GetType()) == i)
+					auto conditional_expr = _arena.New<SyntaxTree::ConditionalExpression>();
+					conditional_expr->expr = expr;
+					conditional_expr->true_expr = ParseExprImpl(Operator::MaxPrio());
+					if (NextToken()->GetType() != ETokenType::Colon)
 					{
-						expr_list[j + 1] = MakeBinaryExpr(op_list[j], expr_list[j], expr_list[j + 1]);
-						op_list.erase(op_list.begin() + j);
-						expr_list.erase(expr_list.begin() + j);
-					}
-					else
-					{
-						++ j;
+						return Error(U"Except ':'");
 					}
+					conditional_expr->false_expr = ParseExprImpl(info.prio);
+					expr = conditional_expr;
+				}
+				else
+				{
+					// a left associative operator takes only tighter operators on its right
+					auto right = ParseBinaryExpr(info.right_assoc ? info.prio : info.prio - 1);
+					expr = MakeBinaryExpr(op, expr, right);
 				}
 			}
-			return *expr_list.begin();
+			return expr;
 		}
 
 		SyntaxTree::NodePtr ParseSingleExpr()
@@ -574,11 +776,21 @@ namespace LANG_NS
 				|| LookAheadToken()->GetType() == ETokenType::Sub
 			)
 			{
-				auto unary_expr = MakeShared<SyntaxTree::UnaryExpression>();
-				unary_expr->op = NextToken()->Clone();
-				unary_expr->expr = ParseSingleExpr();
+				auto unary_expr = _arena.New<SyntaxTree::UnaryExpression>();
+				unary_expr->op = NextToken();
+				unary_expr->expr = ParseBinaryExpr(Operator::UnaryOperandPrio());
 				return unary_expr;
 			}
+			else if (LookAheadToken()->GetType() == ETokenType::LeftParen)
+			{
+				(void)NextToken();
+				auto expr = ParseExpression();
+				if (NextToken()->GetType() != ETokenType::RightParen)
+				{
+					return Error(U"Except ')'");
+				}
+				return expr;
+			}
 			else if (
 				LookAheadToken()->GetType() == ETokenType::Bool
 				|| LookAheadToken()->GetType() == ETokenType::Int
@@ -612,8 +824,8 @@ namespace LANG_NS
 				}
 				else if (LookAheadToken()->GetType() == ETokenType::LeftSquareBrace)
 				{
-					auto binary_expr = MakeShared<SyntaxTree::BinaryExpression>();
-					binary_expr->op = NextToken()->Clone();
+					auto binary_expr = _arena.New<SyntaxTree::BinaryExpression>();
+					binary_expr->op = NextToken();
 					binary_expr->left = expr;
 					binary_expr->right = ParseExpression();
 					if (NextToken()->GetType() != ETokenType::RightSquareBrace)
@@ -626,16 +838,16 @@ namespace LANG_NS
 				else if (LookAheadToken()->GetType() == ETokenType::Dot)
 				{
 					(void)NextToken();
-					auto binary_expr = MakeShared<SyntaxTree::BinaryExpression>();
-					binary_expr->op = TokenT::New(ETokenType::LeftSquareBrace, _current_token->GetLine(), _current_token->GetColumn());
+					auto binary_expr = _arena.New<SyntaxTree::BinaryExpression>();
+					binary_expr->op = TokenT::New(_arena, ETokenType::LeftSquareBrace, _current_token->GetLine(), _current_token->GetColumn());
 					binary_expr->left = expr;
 					if (NextToken()->GetType() != ETokenType::Id)
 					{
 						throw(Exception(U"Except a Id Token"));
 						return {};
 					}
-					auto terminator = MakeShared<SyntaxTree::Terminator>();
-					terminator->token = TokenT::New(_current_token->StringValue(), _current_token->GetLine(), _current_token->GetColumn());
+					auto terminator = _arena.New<SyntaxTree::Terminator>();
+					terminator->token = TokenT::New(_arena, _current_token->StringValue(), _current_token->GetLine(), _current_token->GetColumn());
 					binary_expr->right = terminator;
 					expr = binary_expr;
 				}
@@ -645,7 +857,7 @@ namespace LANG_NS
 
 		SyntaxTree::NodePtr MakeBinaryExpr(SyntaxTree::TokenPtr op, SyntaxTree::NodePtr left, SyntaxTree::NodePtr right)
 		{
-			auto binary_expr = MakeShared<SyntaxTree::BinaryExpression>();
+			auto binary_expr = _arena.New<SyntaxTree::BinaryExpression>();
 			binary_expr->op = op;
 			binary_expr->left = left;
 			binary_expr->right = right;
@@ -654,16 +866,25 @@ namespace LANG_NS
 
 		SyntaxTree::NodePtr ParseTerminator()
 		{
-			auto terminator = MakeShared<SyntaxTree::Terminator>();
+			auto terminator = _arena.New<SyntaxTree::Terminator>();
 			terminator->token = NextToken();
 			return terminator;
 		}
 
 	private:
 		SharedPtr<Scanner> _scanner;
+		Arena& _arena;
 		StringT _module_name;
-		SharedPtr<TokenT> _current_token;
-		SharedPtr<TokenT> _look_ahead_token;
+		TokenT* _current_token = nullptr;
+		TokenT* _look_ahead_token = nullptr;
+		bool _recover = false;
+		TVector<Diagnostic> _diagnostics;
+		SizeT _consumed = 0;
+		SizeT _error_line = 0;
+		SizeT _error_column = 0;
+		bool _scan_failed = false;
+		bool _gave_up = false;
+		bool _ended_early = false;
 		bool _in_loop = false;
 	};
 }
@@ -1,6 +1,8 @@
 #pragma once
+#include <algorithm>
 #include <assert.h>
 #include <codecvt>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <map>
@@ -8,6 +10,7 @@
 #include <optional>
 #include <string>
 #include <string.h>
+#include <unordered_map>
 #include <vector>
 
 #define LANG_NAME SnowLang
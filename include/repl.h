@@ -0,0 +1,200 @@
+#pragma once
+#include "environment.h"
+#include "pre_define.h"
+
+namespace LANG_NS
+{
+    // runs console input one statement at a time
+    //  - lines are gathered until every bracket they open is closed, each line is scanned once for that
+    //  - once balanced the gathered lines are parsed, input that ends too early such as 'x = 1 +' waits for more
+    //  - an if whose branch just closed waits for the next non blank line, which runs it unless it starts with else
+    //  - top level 'var' names are made globals, so they stay visible to later input
+    class Repl
+    {
+    public:
+        explicit Repl(Environment& env)
+            : _env(env)
+        {}
+
+        // true while the input gathered so far is not a complete chunk
+        bool Pending() const
+        {
+            return !_buffer.empty();
+        }
+
+        void Feed(const StringT& line)
+        {
+            auto first = Option<ETokenType>();
+            auto depth = _depth;
+            auto if_branch = _if_branch;
+            auto branch_closed = ScanLine(line, depth, if_branch, first);
+            if (_else_pending)
+            {
+                if (!first)
+                {
+                    return;
+                }
+                if (*first != ETokenType::Else)
+                {
+                    // the if is complete, it runs before the new line is looked at
+                    Run();
+                    depth = 0;
+                    if_branch = false;
+                    branch_closed = ScanLine(line, depth, if_branch, first);
+                }
+                _else_pending = false;
+            }
+            _depth = depth;
+            _if_branch = if_branch;
+            _buffer += line;
+            _buffer += U'\n';
+            if (_depth > 0)
+            {
+                return;
+            }
+            if (branch_closed)
+            {
+                _else_pending = true;
+                return;
+            }
+            Run();
+        }
+
+        // runs whatever is pending, used when the input ends
+        void Flush()
+        {
+            if (Pending())
+            {
+                Run(true);
+            }
+        }
+
+    private:
+        // adds the bracket depth change of one line to depth, strings and comments never span lines
+        //  - if_branch tells whether the top level statement so far is in the branch of an if or else if
+        //  - first is the first token of the line, nothing for a blank line
+        //  - true if the line ends with the closing brace of an if or else if branch at the top level
+        static bool ScanLine(const StringT& line, IntT& depth, bool& if_branch, Option<ETokenType>& first)
+        {
+            bool branch_closed = false;
+            try
+            {
+                Scanner scanner(MakeShared<Unicode::StringReader>(line));
+                for (auto token = scanner.Scan(); token->GetType() != ETokenType::Eof; token = scanner.Scan())
+                {
+                    auto type = token->GetType();
+                    if (!first)
+                    {
+                        first = type;
+                    }
+                    branch_closed = false;
+                    switch (type)
+                    {
+                    case ETokenType::LeftParen:
+                    case ETokenType::LeftSquareBrace:
+                    case ETokenType::LeftBrace:
+                        ++depth;
+                        break;
+                    case ETokenType::RightParen:
+                    case ETokenType::RightSquareBrace:
+                    case ETokenType::RightBrace:
+                        --depth;
+                        branch_closed = type == ETokenType::RightBrace && depth == 0 && if_branch;
+                        break;
+                    case ETokenType::If:
+                        if (depth == 0)
+                        {
+                            if_branch = true;
+                        }
+                        break;
+                    default:
+                        // a plain else branch ends the chain, any other token at the top level starts another statement
+                        if (depth == 0)
+                        {
+                            if_branch = false;
+                        }
+                        break;
+                    }
+                }
+            }
+            catch (const Exception&)
+            {
+                // the parser reports it once the line is run
+            }
+            return branch_closed;
+        }
+
+        void Run(bool at_end = false)
+        {
+            auto reader = MakeShared<Unicode::StringReader>(_buffer);
+            auto scanner = MakeShared<Scanner>(reader);
+            Parser parser(scanner);
+            try
+            {
+                auto ast = parser.Parse();
+                _buffer.clear();
+                _depth = 0;
+                _if_branch = false;
+                GlobalizeVars(scanner->GetArena(), ast);
+                Optimizer(scanner->GetArena(), !_env.OperatorsOverridden()).Optimize(ast);
+                auto proto = Compiler(parser.ModuleName()).Compile(ast);
+                (void)_env.Call(Executor::MakeFunction(proto, nullptr), {});
+            }
+            catch (const Exception & e)
+            {
+                if (parser.EndedEarly() && !at_end)
+                {
+                    return;
+                }
+                _buffer.clear();
+                _depth = 0;
+                _if_branch = false;
+                std::cerr << "Error in LoadString : " << e.Info() << std::endl;
+            }
+        }
+
+        // var a, b = 1, 2 at the top level becomes a, b = 1, 2
+        static void GlobalizeVars(Arena& arena, const SyntaxTree::NodePtr& chunk)
+        {
+            auto block = static_cast<SyntaxTree::Block*>(static_cast<SyntaxTree::Chunk*>(chunk)->block);
+            for (auto iter = block->statements.begin(); iter != block->statements.end(); ++iter)
+            {
+                if ((*iter)->node_type != SyntaxTree::NodeType::VarNameListStatement)
+                {
+                    continue;
+                }
+                auto statement = static_cast<SyntaxTree::VarNameListStatement*>(*iter);
+                auto& names = static_cast<SyntaxTree::NameList*>(statement->name_list)->names;
+                auto assignment = arena.New<SyntaxTree::AssignmentStatement>();
+                auto var_list = arena.New<SyntaxTree::VarList>();
+                for (auto name = names.begin(); name != names.end(); ++name)
+                {
+                    auto key = arena.New<SyntaxTree::Terminator>();
+                    key->token = TokenT::New(arena, (*name)->StringValue(), (*name)->GetLine(), (*name)->GetColumn());
+                    auto var = arena.New<SyntaxTree::VarExpression>();
+                    var->key = key;
+                    var_list->vars.push_back(var);
+                }
+                assignment->var_list = var_list;
+                assignment->expr_list = statement->expr_list;
+                if (!assignment->expr_list)
+                {
+                    auto nil = arena.New<SyntaxTree::Terminator>();
+                    nil->token = TokenT::New(arena, names.front()->GetLine(), names.front()->GetColumn());
+                    auto expr_list = arena.New<SyntaxTree::ExpressionList>();
+                    expr_list->exprs.push_back(nil);
+                    assignment->expr_list = expr_list;
+                }
+                *iter = assignment;
+            }
+        }
+
+    private:
+        Environment& _env;
+        StringT _buffer;
+        IntT _depth = 0;
+        bool _if_branch = false;
+        // the buffer holds an if that is complete unless the next line starts with else
+        bool _else_pending = false;
+    };
+}
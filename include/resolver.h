@@ -0,0 +1,375 @@
+#pragma once
+#include "bytecode.h"
+#include "pre_define.h"
+#include "syntax_tree.h"
+
+namespace LANG_NS
+{
+    // binds every name of a chunk to the variable it refers to before compiling
+    //  - a scope is a chunk, a function, a for statement or a block
+    //  - inside one function a name is visible after its 'var' statement
+    //  - nested functions see every variable an enclosing scope declares, and capture it
+    //  - names without a variable are globals
+    class Resolver
+    {
+    public:
+        class Variable
+        {
+        public:
+            StringT name;
+            // referenced from a nested function, so it must live in a heap scope
+            bool captured = false;
+        };
+
+        void Resolve(const SyntaxTree::NodePtr& node)
+        {
+            Assert(node->node_type == SyntaxTree::NodeType::Chunk);
+            auto chunk = static_cast<SyntaxTree::Chunk*>(node);
+            BeginScope(node, chunk->block);
+            Declare(U"args");
+            ResolveBlockStatements(chunk->block);
+            EndScope();
+        }
+
+        // variables of a scope in declaration order
+        const TVector<SizeT>& ScopeVariables(const SyntaxTree::NodeBase* scope) const
+        {
+            static const TVector<SizeT> _empty;
+            auto iter = _scopes.find(scope);
+            if (iter == _scopes.end())
+            {
+                return _empty;
+            }
+            return iter->second.variables;
+        }
+
+        SizeT FindVariable(const SyntaxTree::NodeBase* scope, const StringT& name) const
+        {
+            auto& names = _scopes.find(scope)->second.names;
+            auto iter = names.find(name);
+            Assert(iter != names.end());
+            return iter->second;
+        }
+
+        // the variable a name, an assigned name or an operator refers to, nothing for globals
+        Option<SizeT> Reference(const SyntaxTree::NodeBase* node) const
+        {
+            auto iter = _references.find(node);
+            if (iter == _references.end())
+            {
+                return Option<SizeT>();
+            }
+            return iter->second;
+        }
+
+        const Variable& GetVariable(SizeT index) const
+        {
+            return _variables[index];
+        }
+
+        SizeT VariableCount() const
+        {
+            return _variables.size();
+        }
+
+    private:
+        class ScopeInfo
+        {
+        public:
+            TVector<SizeT> variables;
+            TMap<StringT, SizeT> names;
+        };
+
+        class ActiveScope
+        {
+        public:
+            const SyntaxTree::NodeBase* node = nullptr;
+            SizeT function_level = 0;
+            // names whose declaration has been resolved already
+            TMap<StringT, SizeT> declared;
+        };
+
+        SizeT AddVariable(ScopeInfo& info, const StringT& name)
+        {
+            auto iter = info.names.find(name);
+            if (iter != info.names.end())
+            {
+                return iter->second;
+            }
+            _variables.push_back(Variable());
+            _variables.back().name = name;
+            info.variables.push_back(_variables.size() - 1);
+            info.names[name] = _variables.size() - 1;
+            return _variables.size() - 1;
+        }
+
+        // block is the body running in this scope, its 'var' names are known up front
+        void BeginScope(const SyntaxTree::NodeBase* node, const SyntaxTree::NodePtr& block)
+        {
+            auto& info = _scopes[node];
+            if (block)
+            {
+                auto& statements = static_cast<SyntaxTree::Block*>(block)->statements;
+                for (auto iter = statements.begin(); iter != statements.end(); ++iter)
+                {
+                    if ((*iter)->node_type != SyntaxTree::NodeType::VarNameListStatement)
+                    {
+                        continue;
+                    }
+                    auto statement = static_cast<SyntaxTree::VarNameListStatement*>(*iter);
+                    auto& names = static_cast<SyntaxTree::NameList*>(statement->name_list)->names;
+                    for (auto name = names.begin(); name != names.end(); ++name)
+                    {
+                        (void)AddVariable(info, (*name)->StringValue());
+                    }
+                }
+            }
+            _active_scopes.push_back(ActiveScope());
+            _active_scopes.back().node = node;
+            _active_scopes.back().function_level = _function_level;
+        }
+
+        void EndScope()
+        {
+            _active_scopes.pop_back();
+        }
+
+        void Declare(const StringT& name)
+        {
+            auto& scope = _active_scopes.back();
+            scope.declared[name] = AddVariable(_scopes[scope.node], name);
+        }
+
+        Option<SizeT> Lookup(const StringT& name)
+        {
+            for (auto iter = _active_scopes.rbegin(); iter != _active_scopes.rend(); ++iter)
+            {
+                if (iter->function_level == _function_level)
+                {
+                    auto found = iter->declared.find(name);
+                    if (found != iter->declared.end())
+                    {
+                        return found->second;
+                    }
+                    continue;
+                }
+                auto& names = _scopes[iter->node].names;
+                auto found = names.find(name);
+                if (found != names.end())
+                {
+                    _variables[found->second].captured = true;
+                    return found->second;
+                }
+            }
+            return Option<SizeT>();
+        }
+
+        void ReferenceName(const SyntaxTree::NodeBase* node, const StringT& name)
+        {
+            auto variable = Lookup(name);
+            if (variable)
+            {
+                _references[node] = *variable;
+            }
+        }
+
+        void ResolveBlockStatements(const SyntaxTree::NodePtr& node)
+        {
+            auto block = static_cast<SyntaxTree::Block*>(node);
+            for (auto iter = block->statements.begin(); iter != block->statements.end(); ++iter)
+            {
+                ResolveStatement(*iter);
+            }
+        }
+
+        void ResolveStatement(const SyntaxTree::NodePtr& node)
+        {
+            switch (node->node_type)
+            {
+            case SyntaxTree::NodeType::Block:
+                BeginScope(node, node);
+                ResolveBlockStatements(node);
+                EndScope();
+                break;
+            case SyntaxTree::NodeType::VarNameListStatement:
+            {
+                auto statement = static_cast<SyntaxTree::VarNameListStatement*>(node);
+                ResolveExpr(statement->expr_list);
+                auto& names = static_cast<SyntaxTree::NameList*>(statement->name_list)->names;
+                for (auto iter = names.begin(); iter != names.end(); ++iter)
+                {
+                    Declare((*iter)->StringValue());
+                }
+                break;
+            }
+            case SyntaxTree::NodeType::AssignmentStatement:
+            {
+                auto statement = static_cast<SyntaxTree::AssignmentStatement*>(node);
+                auto& vars = static_cast<SyntaxTree::VarList*>(statement->var_list)->vars;
+                for (auto iter = vars.begin(); iter != vars.end(); ++iter)
+                {
+                    auto var = static_cast<SyntaxTree::VarExpression*>(*iter);
+                    if (!var->expr)
+                    {
+                        auto key = static_cast<SyntaxTree::Terminator*>(var->key);
+                        ReferenceName(var, key->token->StringValue());
+                        continue;
+                    }
+                    ResolveExpr(var->key);
+                    ResolveExpr(var->expr);
+                }
+                ResolveExpr(statement->expr_list);
+                break;
+            }
+            case SyntaxTree::NodeType::WhileStatement:
+            {
+                auto statement = static_cast<SyntaxTree::WhileStatement*>(node);
+                ResolveExpr(statement->expr);
+                ResolveStatement(statement->block);
+                break;
+            }
+            case SyntaxTree::NodeType::ForStatement:
+            {
+                auto statement = static_cast<SyntaxTree::ForStatement*>(node);
+                auto& names = static_cast<SyntaxTree::NameList*>(statement->var_name_list)->names;
+                BeginScope(node, nullptr);
+                for (auto iter = names.begin(); iter != names.end(); ++iter)
+                {
+                    Declare((*iter)->StringValue());
+                }
+                ResolveExpr(statement->expr);
+                ResolveStatement(statement->block);
+                EndScope();
+                break;
+            }
+            case SyntaxTree::NodeType::BreakStatement:
+            case SyntaxTree::NodeType::ContinueStatement:
+                break;
+            case SyntaxTree::NodeType::ReturnStatement:
+                ResolveExpr(static_cast<SyntaxTree::ReturnStatement*>(node)->exprs);
+                break;
+            default:
+                ResolveExpr(node);
+                break;
+            }
+        }
+
+        void ResolveFunction(const SyntaxTree::NodePtr& node)
+        {
+            auto statement = static_cast<SyntaxTree::FunctionStatement*>(node);
+            auto& names = static_cast<SyntaxTree::NameList*>(statement->var_name_list)->names;
+            ++_function_level;
+            BeginScope(node, statement->block);
+            for (auto iter = names.begin(); iter != names.end(); ++iter)
+            {
+                Declare((*iter)->StringValue());
+            }
+            ResolveBlockStatements(statement->block);
+            EndScope();
+            --_function_level;
+        }
+
+        void ResolveExpr(const SyntaxTree::NodePtr& node)
+        {
+            if (!node)
+            {
+                return;
+            }
+            switch (node->node_type)
+            {
+            case SyntaxTree::NodeType::Terminator:
+            {
+                auto terminator = static_cast<SyntaxTree::Terminator*>(node);
+                if (terminator->token->GetType() == ETokenType::Id)
+                {
+                    ReferenceName(node, terminator->token->StringValue());
+                }
+                break;
+            }
+            case SyntaxTree::NodeType::BinaryExpression:
+            {
+                auto expr = static_cast<SyntaxTree::BinaryExpression*>(node);
+                auto op = Bytecode::BinaryOpCode(expr->op->GetType());
+                if (op)
+                {
+                    ReferenceName(node, Bytecode::OperatorFunctionName(*op).StringValue());
+                }
+                ResolveExpr(expr->left);
+                ResolveExpr(expr->right);
+                break;
+            }
+            case SyntaxTree::NodeType::UnaryExpression:
+            {
+                auto expr = static_cast<SyntaxTree::UnaryExpression*>(node);
+                auto op = Bytecode::UnaryOpCode(expr->op->GetType());
+                if (op)
+                {
+                    ReferenceName(node, Bytecode::OperatorFunctionName(*op).StringValue());
+                }
+                ResolveExpr(expr->expr);
+                break;
+            }
+            case SyntaxTree::NodeType::ConditionalExpression:
+            {
+                auto expr = static_cast<SyntaxTree::ConditionalExpression*>(node);
+                ResolveExpr(expr->expr);
+                ResolveExpr(expr->true_expr);
+                ResolveExpr(expr->false_expr);
+                break;
+            }
+            case SyntaxTree::NodeType::FunctionStatement:
+                ResolveFunction(node);
+                break;
+            case SyntaxTree::NodeType::CallStatement:
+            {
+                auto statement = static_cast<SyntaxTree::CallStatement*>(node);
+                ResolveExpr(statement->func);
+                ResolveExpr(statement->expr_list);
+                break;
+            }
+            case SyntaxTree::NodeType::IfStatement:
+            {
+                auto statement = static_cast<SyntaxTree::IfStatement*>(node);
+                ResolveExpr(statement->expr);
+                ResolveStatement(statement->true_branch);
+                if (statement->false_branch)
+                {
+                    ResolveExpr(statement->false_branch);
+                }
+                break;
+            }
+            case SyntaxTree::NodeType::ElseStatement:
+                ResolveStatement(static_cast<SyntaxTree::ElseStatement*>(node)->block);
+                break;
+            case SyntaxTree::NodeType::ArrayStatement:
+                ResolveExpr(static_cast<SyntaxTree::ArrayStatement*>(node)->expr_list);
+                break;
+            case SyntaxTree::NodeType::MapStatement:
+            {
+                auto statement = static_cast<SyntaxTree::MapStatement*>(node);
+                ResolveExpr(statement->key_expr_list);
+                ResolveExpr(statement->val_expr_list);
+                break;
+            }
+            case SyntaxTree::NodeType::ExpressionList:
+            {
+                auto& exprs = static_cast<SyntaxTree::ExpressionList*>(node)->exprs;
+                for (auto iter = exprs.begin(); iter != exprs.end(); ++iter)
+                {
+                    ResolveExpr(*iter);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+    private:
+        TVector<Variable> _variables;
+        TMap<const SyntaxTree::NodeBase*, ScopeInfo> _scopes;
+        TVector<ActiveScope> _active_scopes;
+        TMap<const SyntaxTree::NodeBase*, SizeT> _references;
+        SizeT _function_level = 0;
+    };
+}
@@ -17,7 +17,7 @@ namespace LANG_NS
 
         }
 
-        SharedPtr<TokenT> Scan()
+        TokenT* Scan()
         {
             if (!_current)
             {
@@ -38,42 +38,8 @@ namespace LANG_NS
                 {
                     NewLine();
                 }
-                else if (*_current == '&')
-                {
-                    auto c = Next();
-                    if (c == '&')
-                    {
-                        _current = Next();
-                        return NormalToken(ETokenType::And);
-                    }
-                    else
-                    {
-                        _current = c;
-                        return NormalToken(ETokenType::BitwiseAnd);
-                    }
-                }
-                else if (*_current == '|')
-                {
-                    auto c = Next();
-                    if (c == '|')
-                    {
-                        _current = Next();
-                        return NormalToken(ETokenType::Or);
-                    }
-                    else
-                    {
-                        _current = c;
-                        return NormalToken(ETokenType::BitwiseOr);
-                    }
-                }
                 else if (
-                    *_current == '~'
-                    || *_current == '^'
-                    || *_current == '+'
-                    || *_current == '-'
-                    || *_current == '*'
-                    || *_current == '%'
-                    || *_current == '('
+                    *_current == '('
                     || *_current == ')'
                     || *_current == '['
                     || *_current == ']'
@@ -90,24 +56,39 @@ namespace LANG_NS
                 else if (*_current == '/')
                 {
                     auto c = Next();
-                    if (*c == '/')
+                    if (c && *c == '/')
                     {
                         Comment();
                     }
                     else
                     {
+                        _buffer.clear();
+                        _buffer += U'/';
                         _current = c;
-                        return NormalToken(ETokenType::Div);
+                        return OperatorToken();
                     }
                 }
                 else if (
-                    *_current == '='
+                    *_current == '~'
+                    || *_current == '^'
+                    || *_current == '+'
+                    || *_current == '-'
+                    || *_current == '*'
+                    || *_current == '%'
+                    || *_current == '&'
+                    || *_current == '|'
+                    || *_current == '='
                     || *_current == '<'
                     || *_current == '>'
                     || *_current == '!'
+                    || *_current == '?'
+                    || *_current == ':'
                 )
                 {
-                    return XEquelToken();
+                    _buffer.clear();
+                    _buffer += *_current;
+                    _current = Next();
+                    return OperatorToken();
                 }
                 else if (*_current == '.')
                 {
@@ -146,7 +127,7 @@ namespace LANG_NS
                     return Error(U"Unexcept Character");
                 }
             }
-            return TokenT::New();
+            return TokenT::New(_arena, ETokenType::Eof, _line, _column);
         } 
         
         const StringT ModuleName() const
@@ -154,8 +135,41 @@ namespace LANG_NS
             return _module_name;
         }
 
+        // owns every token scanned and every syntax tree node built from them
+        Arena& GetArena()
+        {
+            return _arena;
+        }
+
+        SizeT GetLine() const
+        {
+            return _line;
+        }
+
+        SizeT GetColumn() const
+        {
+            return _column;
+        }
+
+        // drops the character a scan error stopped at, so scanning can go on after the error
+        void Skip()
+        {
+            if (!_current)
+            {
+                return;
+            }
+            if (*_current == '\r' || *_current == '\n')
+            {
+                NewLine();
+            }
+            else
+            {
+                _current = Next();
+            }
+        }
+
     private:
-        SharedPtr<TokenT> Error(const StringT& err_info) const
+        TokenT* Error(const StringT& err_info) const
         {
             StringT err_msg(err_info);
             err_msg += U" near '";
@@ -167,7 +181,7 @@ namespace LANG_NS
             err_msg += U" column ";
             err_msg += ToString(_column);
             throw(Exception(err_msg));
-            return TokenT::New();
+            return nullptr;
         }
 
         Option<CharT> Next()
@@ -204,19 +218,22 @@ namespace LANG_NS
             }
         }
 
-        SharedPtr<TokenT> NormalToken(ETokenType t)
+        TokenT* NormalToken(ETokenType t)
         {
-            return TokenT::New(t, _line, _column);
+            return TokenT::New(_arena, t, _line, _column);
         }
 
-        SharedPtr<TokenT> XEquelToken()
+        // the longest operator starting with the character in _buffer, so '**=' is one token
+        TokenT* OperatorToken()
         {
-            _buffer.clear();
-            _buffer += *_current;
-            _current = Next();
-            if (*_current == '=')
+            while (_current)
             {
                 _buffer += *_current;
+                if (!TokenT::CheckKeyword(_buffer))
+                {
+                    _buffer.pop_back();
+                    break;
+                }
                 _current = Next();
             }
 
@@ -225,7 +242,7 @@ namespace LANG_NS
             return NormalToken(*token_type);
         }
 
-        SharedPtr<TokenT> NumberToken(bool has_dot)
+        TokenT* NumberToken(bool has_dot)
         {
             bool scientific_notation = false;
             if (!has_dot)
@@ -287,12 +304,12 @@ namespace LANG_NS
             }
             if (has_dot || scientific_notation)
             {
-                return TokenT::New(StringToFloat(_buffer), _line, _column);
+                return TokenT::New(_arena, StringToFloat(_buffer), _line, _column);
             }
-            return TokenT::New(StringToInt(_buffer), _line, _column);
+            return TokenT::New(_arena, StringToInt(_buffer), _line, _column);
         }
 
-        SharedPtr<TokenT> SinglelineStringToken()
+        TokenT* SinglelineStringToken()
         {
             auto quote = _current;
             _buffer.clear();
@@ -313,7 +330,7 @@ namespace LANG_NS
                 }
             }
             _current = Next();
-            return TokenT::New(_buffer, _line, _column);
+            return TokenT::New(_arena, _buffer, _line, _column);
         }
 
         Option<StringT> StringCharacter()
@@ -374,7 +391,7 @@ namespace LANG_NS
             return Option<StringT>();
         }
 
-        SharedPtr<TokenT> IdToken()
+        TokenT* IdToken()
         {
             _buffer.clear();
             _buffer += *_current;
@@ -395,15 +412,15 @@ namespace LANG_NS
             {
                 if (*token_type == ETokenType::Nil)
                 {
-                    return TokenT::New(_line, _column);
+                    return TokenT::New(_arena, _line, _column);
                 }
                 else if (*token_type == ETokenType::Bool)
                 {
-                    return TokenT::New(_buffer == U"true", _line, _column);
+                    return TokenT::New(_arena, _buffer == U"true", _line, _column);
                 }
                 return NormalToken(*token_type);
             }
-            return TokenT::NewId(_buffer, _line, _column);
+            return TokenT::NewId(_arena, _buffer, _line, _column);
         }
 
     private:
@@ -413,5 +430,6 @@ namespace LANG_NS
         SizeT _line = 1;
         SizeT _column = 0;
         StringT _buffer;
+        Arena _arena;
     };
 }
@@ -7,36 +7,6 @@ namespace LANG_NS
 {
     namespace SyntaxTree
     {
-        class ControlException : public std::exception
-        {
-        public:
-            enum class EType
-            {
-                Return = 0,
-                Break,
-                Continute,
-            };
-
-            ControlException(EType t, ValuePtrList v = ValuePtrList())
-                : ce_type(t)
-                , ce_values(v)
-            {
-            }
-
-        public:
-            EType ce_type;
-            ValuePtrList ce_values;
-        };
-
-        static ValuePtr GetValueFromList(const ValuePtrList& values, SizeT index = 0)
-        {
-            if (values.size() <= index)
-            {
-                return Value::New();
-            }
-            return values[index];
-        }
-
         enum class NodeType
         {
             Chunk = 0,
@@ -50,6 +20,7 @@ namespace LANG_NS
             ElseStatement,
             WhileStatement,
             BreakStatement,
+            ContinueStatement,
             ForStatement,
             ArrayStatement,
             MapStatement,
@@ -58,6 +29,7 @@ namespace LANG_NS
             ExpressionList,
             BinaryExpression,
             UnaryExpression,
+            ConditionalExpression,
             VarExpression,
             Terminator,
         };
@@ -68,14 +40,14 @@ namespace LANG_NS
             NodeBase(NodeType t)
                 : node_type(t) 
             {}
-            virtual ~NodeBase() {}
             NodeType node_type;
         };
 
-        using NodePtr = SharedPtr<NodeBase>;
-        using NodePtrList = TVector<SharedPtr<NodeBase>>;
-        using TokenPtr = SharedPtr<TokenT>;
-        using TokenPtrList = TVector<SharedPtr<TokenT>>;
+        // nodes and tokens are owned by the arena of the compilation that made them
+        using NodePtr = NodeBase*;
+        using NodePtrList = TVector<NodeBase*>;
+        using TokenPtr = TokenT*;
+        using TokenPtrList = TVector<TokenT*>;
 
 #define DEF_SYNTAX_TREE_NODE_TYPE(type_name, var_list) \
         class type_name : public NodeBase \
@@ -86,7 +58,7 @@ namespace LANG_NS
         }
 
         DEF_SYNTAX_TREE_NODE_TYPE(Chunk,
-            NodePtr block;
+            NodePtr block = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(Block,
@@ -94,60 +66,64 @@ namespace LANG_NS
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(FunctionStatement,
-            TokenPtr name;
-            NodePtr var_name_list;      // NameList
-            NodePtr block;
+            TokenPtr name = nullptr;
+            NodePtr var_name_list = nullptr;      // NameList
+            NodePtr block = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(ReturnStatement,
-            NodePtr exprs;
+            NodePtr exprs = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(CallStatement,
-            NodePtr func;
-            NodePtr expr_list;
+            NodePtr func = nullptr;
+            NodePtr expr_list = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(VarNameListStatement,
-            NodePtr name_list;
-            NodePtr expr_list;
+            NodePtr name_list = nullptr;
+            NodePtr expr_list = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(AssignmentStatement,
-            NodePtr var_list;
-            NodePtr expr_list;
+            NodePtr var_list = nullptr;
+            NodePtr expr_list = nullptr;
+            // a op= b, expr_list holds a op b and its left operand shares the nodes of the target
+            bool compound = false;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(IfStatement,
-            NodePtr expr;
-            NodePtr true_branch;
-            NodePtr false_branch;
+            NodePtr expr = nullptr;
+            NodePtr true_branch = nullptr;
+            NodePtr false_branch = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(ElseStatement,
-            NodePtr block;
+            NodePtr block = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(WhileStatement,
-            NodePtr expr;
-            NodePtr block;
+            NodePtr expr = nullptr;
+            NodePtr block = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(BreakStatement, );
 
+        DEF_SYNTAX_TREE_NODE_TYPE(ContinueStatement, );
+
         DEF_SYNTAX_TREE_NODE_TYPE(ForStatement,
-            NodePtr var_name_list;
-            NodePtr expr;
-            NodePtr block;
+            NodePtr var_name_list = nullptr;
+            NodePtr expr = nullptr;
+            NodePtr block = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(ArrayStatement,
-            NodePtr expr_list;
+            NodePtr expr_list = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(MapStatement,
-            NodePtr key_expr_list;
-            NodePtr val_expr_list;
+            NodePtr key_expr_list = nullptr;
+            NodePtr val_expr_list = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(NameList,
@@ -163,50 +139,57 @@ namespace LANG_NS
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(BinaryExpression,
-            NodePtr left;
-            NodePtr right;
-            TokenPtr op;
+            NodePtr left = nullptr;
+            NodePtr right = nullptr;
+            TokenPtr op = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(UnaryExpression,
-            NodePtr expr;
-            TokenPtr op;
+            NodePtr expr = nullptr;
+            TokenPtr op = nullptr;
+        );
+
+        // expr ? true_expr : false_expr
+        DEF_SYNTAX_TREE_NODE_TYPE(ConditionalExpression,
+            NodePtr expr = nullptr;
+            NodePtr true_expr = nullptr;
+            NodePtr false_expr = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(VarExpression,
-            NodePtr expr;
-            NodePtr key;
+            NodePtr expr = nullptr;
+            NodePtr key = nullptr;
         );
 
         DEF_SYNTAX_TREE_NODE_TYPE(Terminator,
-            TokenPtr token;
+            TokenPtr token = nullptr;
         );
 
 #undef DEF_SYNTAX_TREE_NODE_TYPE
 
-        static SharedPtr<VarExpression> Node2VarExpression(NodePtr node)
+        static VarExpression* Node2VarExpression(Arena& arena, NodePtr node)
         {
             if (node->node_type == NodeType::Terminator)
             {
-                auto terminator = std::static_pointer_cast<SyntaxTree::Terminator>(node);
+                auto terminator = static_cast<SyntaxTree::Terminator*>(node);
                 if (terminator->token->GetType() != ETokenType::Id)
                 {
                     return nullptr;
                 }
-                auto prefix_expr = MakeShared<VarExpression>();
-                auto key_terminator = MakeShared<Terminator>();
-                key_terminator->token = TokenT::New(terminator->token->StringValue(), terminator->token->GetLine(), terminator->token->GetColumn());
+                auto prefix_expr = arena.New<VarExpression>();
+                auto key_terminator = arena.New<Terminator>();
+                key_terminator->token = TokenT::New(arena, terminator->token->StringValue(), terminator->token->GetLine(), terminator->token->GetColumn());
                 prefix_expr->key = key_terminator;
                 return prefix_expr;
             }
             else if (node->node_type == NodeType::BinaryExpression)
             {
-                auto binary_expr = std::static_pointer_cast<SyntaxTree::BinaryExpression>(node);
+                auto binary_expr = static_cast<SyntaxTree::BinaryExpression*>(node);
                 if (binary_expr->op->GetType() != ETokenType::LeftSquareBrace)
                 {
                     return nullptr;
                 }
-                auto prefix_expr = MakeShared<VarExpression>();
+                auto prefix_expr = arena.New<VarExpression>();
                 prefix_expr->expr = binary_expr->left;
                 prefix_expr->key = binary_expr->right;
                 return prefix_expr;
@@ -221,14 +204,13 @@ namespace LANG_NS
         {
             using std::cout;
             using std::endl;
-            using std::static_pointer_cast;
             cout << endl;
             switch (node->node_type)
             {
             case NodeType::Chunk:
             {
                 cout << std::string(tab, '\t') << "[Chunk]" << endl;
-                auto chunk = static_pointer_cast<SyntaxTree::Chunk>(node);
+                auto chunk = static_cast<SyntaxTree::Chunk*>(node);
                 cout << std::string(tab, '\t') << "block = ";
                 DebugPrint(chunk->block, tab + 1);
                 break;
@@ -236,7 +218,7 @@ namespace LANG_NS
             case NodeType::Block:
             {
                 cout << std::string(tab, '\t') << "[Block]" << endl;
-                auto block = static_pointer_cast<SyntaxTree::Block>(node);
+                auto block = static_cast<SyntaxTree::Block*>(node);
                 for (auto iter = block->statements.begin(); iter != block->statements.end(); ++iter)
                 {
                     cout << std::string(tab, '\t') << "statement = ";
@@ -247,7 +229,7 @@ namespace LANG_NS
             case NodeType::FunctionStatement:
             {
                 cout << std::string(tab, '\t') << "[FunctionStatement]" << endl;
-                auto function_statement = static_pointer_cast<SyntaxTree::FunctionStatement>(node);
+                auto function_statement = static_cast<SyntaxTree::FunctionStatement*>(node);
                 if (function_statement->name)
                 {
                     cout << std::string(tab, '\t') << "name = " << function_statement->name->ToString() << endl;
@@ -265,7 +247,7 @@ namespace LANG_NS
             case NodeType::ReturnStatement:
             {
                 cout << std::string(tab, '\t') << "[ReturnStatement]" << endl;
-                auto return_statement = static_pointer_cast<SyntaxTree::ReturnStatement>(node);
+                auto return_statement = static_cast<SyntaxTree::ReturnStatement*>(node);
                 cout << std::string(tab, '\t') << "exprs = ";
                 DebugPrint(return_statement->exprs, tab + 1);
                 break;
@@ -273,7 +255,7 @@ namespace LANG_NS
             case NodeType::CallStatement:
             {
                 cout << std::string(tab, '\t') << "[CallStatement]" << endl;
-                auto call_statement = static_pointer_cast<SyntaxTree::CallStatement>(node);
+                auto call_statement = static_cast<SyntaxTree::CallStatement*>(node);
                 cout << std::string(tab, '\t') << "func = ";
                 DebugPrint(call_statement->func, tab + 1);
                 cout << std::string(tab, '\t') << "expr_list = ";
@@ -283,7 +265,7 @@ namespace LANG_NS
             case NodeType::WhileStatement:
             {
                 cout << std::string(tab, '\t') << "[WhileStatement]" << endl;
-                auto while_statement = static_pointer_cast<SyntaxTree::WhileStatement>(node);
+                auto while_statement = static_cast<SyntaxTree::WhileStatement*>(node);
                 cout << std::string(tab, '\t') << "expr = ";
                 DebugPrint(while_statement->expr, tab + 1);
                 cout << std::string(tab, '\t') << "block = ";
@@ -295,10 +277,15 @@ namespace LANG_NS
                 cout << std::string(tab, '\t') << "[BreakStatement]" << endl;
                 break;
             }
+            case NodeType::ContinueStatement:
+            {
+                cout << std::string(tab, '\t') << "[ContinueStatement]" << endl;
+                break;
+            }
             case NodeType::VarNameListStatement:
             {
                 cout << std::string(tab, '\t') << "[VarNameListStatement]" << endl;
-                auto var_define_statement = static_pointer_cast<SyntaxTree::VarNameListStatement>(node);
+                auto var_define_statement = static_cast<SyntaxTree::VarNameListStatement*>(node);
                 cout << std::string(tab, '\t') << "name_list = ";
                 DebugPrint(var_define_statement->name_list, tab + 1);
                 cout << std::string(tab, '\t') << "expr_list = ";
@@ -308,7 +295,7 @@ namespace LANG_NS
             case NodeType::AssignmentStatement:
             {
                 cout << std::string(tab, '\t') << "[AssignmentStatement]" << endl;
-                auto assignment_statement = static_pointer_cast<SyntaxTree::AssignmentStatement>(node);
+                auto assignment_statement = static_cast<SyntaxTree::AssignmentStatement*>(node);
                 cout << std::string(tab, '\t') << "var_list = ";
                 DebugPrint(assignment_statement->var_list, tab + 1);
                 cout << std::string(tab, '\t') << "expr_list = ";
@@ -318,7 +305,7 @@ namespace LANG_NS
             case NodeType::IfStatement:
             {
                 cout << std::string(tab, '\t') << "[IfStatement]" << endl;
-                auto if_statement = static_pointer_cast<SyntaxTree::IfStatement>(node);
+                auto if_statement = static_cast<SyntaxTree::IfStatement*>(node);
                 cout << std::string(tab, '\t') << "expr = ";
                 DebugPrint(if_statement->expr, tab + 1);
                 cout << std::string(tab, '\t') << "true_branch = ";
@@ -330,7 +317,7 @@ namespace LANG_NS
             case NodeType::ElseStatement:
             {
                 cout << std::string(tab, '\t') << "[ElseStatement]" << endl;
-                auto else_statement = static_pointer_cast<SyntaxTree::ElseStatement>(node);
+                auto else_statement = static_cast<SyntaxTree::ElseStatement*>(node);
                 cout << std::string(tab, '\t') << "block = ";
                 DebugPrint(else_statement->block, tab + 1);
                 break;
@@ -338,7 +325,7 @@ namespace LANG_NS
             case NodeType::NameList:
             {
                 cout << std::string(tab, '\t') << "[NameList]" << endl;
-                auto name_list = static_pointer_cast<SyntaxTree::NameList>(node);
+                auto name_list = static_cast<SyntaxTree::NameList*>(node);
                 for (auto iter = name_list->names.begin(); iter != name_list->names.end(); ++iter)
                 {
                     cout << std::string(tab, '\t') << "name = " << (*iter)->ToString() << endl;
@@ -348,7 +335,7 @@ namespace LANG_NS
             case NodeType::VarList:
             {
                 cout << std::string(tab, '\t') << "[VarList]" << endl;
-                auto var_list = static_pointer_cast<SyntaxTree::VarList>(node);
+                auto var_list = static_cast<SyntaxTree::VarList*>(node);
                 for (auto iter = var_list->vars.begin(); iter != var_list->vars.end(); ++iter)
                 {
                     cout << std::string(tab, '\t') << "var = ";
@@ -359,7 +346,7 @@ namespace LANG_NS
             case NodeType::ExpressionList:
             {
                 cout << std::string(tab, '\t') << "[ExpressionList]" << endl;
-                auto expr_list = static_pointer_cast<SyntaxTree::ExpressionList>(node);
+                auto expr_list = static_cast<SyntaxTree::ExpressionList*>(node);
                 for (auto iter = expr_list->exprs.begin(); iter != expr_list->exprs.end(); ++iter)
                 {
                     cout << std::string(tab, '\t') << "expr = ";
@@ -370,7 +357,7 @@ namespace LANG_NS
             case NodeType::BinaryExpression:
             {
                 cout << std::string(tab, '\t') << "[BinaryExpression]" << endl;
-                auto expr = static_pointer_cast<SyntaxTree::BinaryExpression>(node);
+                auto expr = static_cast<SyntaxTree::BinaryExpression*>(node);
                 cout << std::string(tab, '\t') << "op = " << expr->op->ToString() << endl;
                 cout << std::string(tab, '\t') << "left = ";
                 DebugPrint(expr->left, tab + 1);
@@ -381,16 +368,28 @@ namespace LANG_NS
             case NodeType::UnaryExpression:
             {
                 cout << std::string(tab, '\t') << "[UnaryExpression]" << endl;
-                auto expr = static_pointer_cast<SyntaxTree::UnaryExpression>(node);
+                auto expr = static_cast<SyntaxTree::UnaryExpression*>(node);
                 cout << std::string(tab, '\t') << "op = " << expr->op->ToString() << endl;
                 cout << std::string(tab, '\t') << "expr = ";
                 DebugPrint(expr->expr, tab + 1);
                 break;
             }
+            case NodeType::ConditionalExpression:
+            {
+                cout << std::string(tab, '\t') << "[ConditionalExpression]" << endl;
+                auto expr = static_cast<SyntaxTree::ConditionalExpression*>(node);
+                cout << std::string(tab, '\t') << "expr = ";
+                DebugPrint(expr->expr, tab + 1);
+                cout << std::string(tab, '\t') << "true_expr = ";
+                DebugPrint(expr->true_expr, tab + 1);
+                cout << std::string(tab, '\t') << "false_expr = ";
+                DebugPrint(expr->false_expr, tab + 1);
+                break;
+            }
             case NodeType::Terminator:
             {
                 cout << std::string(tab, '\t') << "[Terminator]" << endl;
-                auto terminator = static_pointer_cast<SyntaxTree::Terminator>(node);
+                auto terminator = static_cast<SyntaxTree::Terminator*>(node);
                 cout << std::string(tab, '\t') << terminator->token->ToString() << endl;
                 break;
             }
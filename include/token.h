@@ -1,4 +1,5 @@
 #pragma once
+#include "arena.h"
 #include "pre_define.h"
 #include "unicode.h"
 
@@ -14,6 +15,7 @@ namespace LANG_NS
         xx(Else, "else") \
         xx(While, "while") \
         xx(Break, "break") \
+        xx(Continue, "continue") \
         xx(For, "for") \
         xx(In, "in") \
         xx(BitwiseAnd, "&") \
@@ -28,7 +30,17 @@ namespace LANG_NS
         xx(Mul, "*") \
         xx(Div, "/") \
         xx(Mod, "%") \
+        xx(Pow, "**") \
         xx(Assign, "=") \
+        xx(AddAssign, "+=") \
+        xx(SubAssign, "-=") \
+        xx(MulAssign, "*=") \
+        xx(DivAssign, "/=") \
+        xx(ModAssign, "%=") \
+        xx(PowAssign, "**=") \
+        xx(BitwiseAndAssign, "&=") \
+        xx(BitwiseOrAssign, "|=") \
+        xx(XorAssign, "^=") \
         xx(Equel, "==") \
         xx(Greater, ">") \
         xx(GreaterEquel, ">=") \
@@ -43,11 +55,13 @@ namespace LANG_NS
         xx(RightBrace, "}") \
         xx(Comma, ",") \
         xx(Dot, ".") \
+        xx(Question, "?") \
+        xx(Colon, ":") \
         xx(Eof, "<eof>")
 
     #define TOKEN_NAME_2ENUM(kw, kws) kw,
     #define TOKEN_NAME_TYPE2STR(kw, kws) {ETokenType::kw, U"<token_type " kws " >"},
-    #define TOKEN_NAME_STR2TYPE(kw, kws) {U"" kws, ETokenType::kw},
+    #define TOKEN_NAME_KEYWORD(kw, kws) {U"" kws, sizeof(U"" kws) / sizeof(CharT) - 1, ETokenType::kw},
 
     enum class ETokenType
     {
@@ -60,16 +74,99 @@ namespace LANG_NS
         TOKEN_NAME_MAKER(TOKEN_NAME_2ENUM)
     };
 
+    // Eof stays the last token type, tables indexed by token type use this size
+    static constexpr SizeT TokenTypeCount = static_cast<SizeT>(ETokenType::Eof) + 1;
+
     TMap<ETokenType, StringT> TokenNameMapByType = {
         TOKEN_NAME_MAKER(TOKEN_NAME_TYPE2STR)
     };
 
-    TMap<StringT, ETokenType> TokenTypeMapByName = {
-        TOKEN_NAME_MAKER(TOKEN_NAME_STR2TYPE)
-    };
-    
+    // keywords and punctuators are found without building strings or searching a map
+    //  - a single character goes through a table indexed by the character
+    //  - longer names go through a perfect hash of first character, last character and size,
+    //    a new keyword that collides fails to compile
+    namespace Keyword
+    {
+        class Entry
+        {
+        public:
+            const CharT* name = nullptr;
+            SizeT size = 0;
+            ETokenType type = ETokenType::Nil;
+        };
+
+        static constexpr Entry Entries[] = {
+            TOKEN_NAME_MAKER(TOKEN_NAME_KEYWORD)
+            {U"nil", 3, ETokenType::Nil},
+        };
+
+        static constexpr SizeT HashSize = 256;
+        static constexpr SizeT CharTableSize = 128;
+
+        static constexpr SizeT Hash(const CharT* name, SizeT size)
+        {
+            return (name[0] * 7 + name[size - 1] * 2 + size) & (HashSize - 1);
+        }
+
+        class Tables
+        {
+        public:
+            Entry slots[HashSize] = {};
+            // Nil for characters that are no punctuator, no keyword of type Nil is a single character
+            ETokenType chars[CharTableSize] = {};
+            bool collision = false;
+        };
+
+        static constexpr Tables MakeTables()
+        {
+            Tables tables;
+            for (auto entry : Entries)
+            {
+                // true and false are both literals of type Bool
+                if (entry.type == ETokenType::True || entry.type == ETokenType::False)
+                {
+                    entry.type = ETokenType::Bool;
+                }
+                auto& slot = tables.slots[Hash(entry.name, entry.size)];
+                tables.collision = tables.collision || slot.size != 0;
+                slot = entry;
+                if (entry.size == 1 && entry.name[0] < CharTableSize)
+                {
+                    tables.chars[entry.name[0]] = entry.type;
+                }
+            }
+            return tables;
+        }
+
+        static constexpr Tables KeywordTables = MakeTables();
+        StaticAssert(!KeywordTables.collision, "two keywords share a hash slot, change Keyword::Hash");
+
+        static Option<ETokenType> Find(const CharT* name, SizeT size)
+        {
+            if (size == 0)
+            {
+                return Option<ETokenType>();
+            }
+            auto& slot = KeywordTables.slots[Hash(name, size)];
+            if (slot.size != size || !std::equal(name, name + size, slot.name))
+            {
+                return Option<ETokenType>();
+            }
+            return Option<ETokenType>(slot.type);
+        }
+
+        static Option<ETokenType> Find(CharT c)
+        {
+            if (c >= CharTableSize || KeywordTables.chars[c] == ETokenType::Nil)
+            {
+                return Option<ETokenType>();
+            }
+            return Option<ETokenType>(KeywordTables.chars[c]);
+        }
+    }
+
     #undef TOKEN_NAME_2ENUM
-    #undef TOKEN_NAME_STR2TYPE
+    #undef TOKEN_NAME_KEYWORD
     #undef TOKEN_NAME_TYPE2STR
     #undef TOKEN_NAME_MAKER
 
@@ -78,28 +175,15 @@ namespace LANG_NS
     public:
         static Option<ETokenType> CheckKeyword(const CharT c)
         {
-            return CheckKeyword(StringT(1, c));
+            return Keyword::Find(c);
         }
 
         static Option<ETokenType> CheckKeyword(const StringT& str)
         {
-            if (str == U"nil")
-            {
-                return Option<ETokenType>(ETokenType::Nil);
-            }
-            else if (str == U"true" || str == U"false")
-            {
-                return Option<ETokenType>(ETokenType::Bool);
-            }
-            auto iter = TokenTypeMapByName.find(str);
-            if (iter == TokenTypeMapByName.end())
-            {
-                return Option<ETokenType>();
-            }
-            return Option<ETokenType>(iter->second);
+            return Keyword::Find(str.data(), str.size());
         }
 
-        static SharedPtr<TokenT> New(const ETokenType t, SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, const ETokenType t, SizeT line, SizeT column)
         {
             Assert(
                 t != ETokenType::Bool
@@ -111,94 +195,83 @@ namespace LANG_NS
                 && t != ETokenType::True
                 && t != ETokenType::False
             );
-            return SharedPtr<TokenT>(new TokenT(t, line, column));
+            return Make(arena, t, line, column);
         }
 
-        static SharedPtr<TokenT> New()
+        static TokenT* New(Arena& arena)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Eof, 0, 0));
-            return token;
+            return Make(arena, ETokenType::Eof, 0, 0);
         }
 
-        static SharedPtr<TokenT> New(SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Nil, line, column));
-            return token;
+            return Make(arena, ETokenType::Nil, line, column);
         }
 
-        static SharedPtr<TokenT> New(const BoolT b, SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, const BoolT b, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Bool, line, column));
+            auto token = Make(arena, ETokenType::Bool, line, column);
             token->_value.b = b;
             return token;
         }
 
-        static SharedPtr<TokenT> New(const IntT i, SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, const IntT i, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Int, line, column));
+            auto token = Make(arena, ETokenType::Int, line, column);
             token->_value.i = i;
             return token;
         }
 
-        static SharedPtr<TokenT> New(const int i, SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, const int i, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Int, line, column));
+            auto token = Make(arena, ETokenType::Int, line, column);
             token->_value.i = i;
             return token;
         }
 
-        static SharedPtr<TokenT> New(const FloatT f, SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, const FloatT f, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Float, line, column));
+            auto token = Make(arena, ETokenType::Float, line, column);
             token->_value.f = f;
             return token;
         }
 
-        static SharedPtr<TokenT> New(const float f, SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, const float f, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Float, line, column));
+            auto token = Make(arena, ETokenType::Float, line, column);
             token->_value.f = f;
             return token;
         }
 
-        static SharedPtr<TokenT> New(const StringT& s, SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, const StringT& s, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::String, line, column));
-            (*token->_value.s) = s;
+            auto token = Make(arena, ETokenType::String, line, column);
+            token->_value.s = arena.New<StringT>(s);
             return token;
         }
 
-        static SharedPtr<TokenT> New(const CharT* s, SizeT line, SizeT column)
+        static TokenT* New(Arena& arena, const CharT* s, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::String, line, column));
-            (*token->_value.s) = s;
+            auto token = Make(arena, ETokenType::String, line, column);
+            token->_value.s = arena.New<StringT>(s);
             return token;
         }
 
-        static SharedPtr<TokenT> NewId(const StringT& id, SizeT line, SizeT column)
+        static TokenT* NewId(Arena& arena, const StringT& id, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Id, line, column));
-            (*token->_value.s) = id;
+            auto token = Make(arena, ETokenType::Id, line, column);
+            token->_value.s = arena.New<StringT>(id);
             return token;
         }
 
-        static SharedPtr<TokenT> NewId(const CharT* s, SizeT line, SizeT column)
+        static TokenT* NewId(Arena& arena, const CharT* s, SizeT line, SizeT column)
         {
-            SharedPtr<TokenT> token(new TokenT(ETokenType::Id, line, column));
-            (*token->_value.s) = s;
+            auto token = Make(arena, ETokenType::Id, line, column);
+            token->_value.s = arena.New<StringT>(s);
             return token;
         }
 
     public:
-        virtual ~TokenT()
-        {
-            if (_type == ETokenType::String || _type == ETokenType::Id)
-            {
-                delete _value.s;
-                _value.s = nullptr;
-            }
-        }
-
         ETokenType GetType() const
         {
             return _type;
@@ -282,6 +355,7 @@ namespace LANG_NS
                 {ETokenType::Mul, U"__mul"},
                 {ETokenType::Div, U"__div"},
                 {ETokenType::Mod, U"__mod"},
+                {ETokenType::Pow, U"__pow"},
                 {ETokenType::Equel, U"__equel"},
                 {ETokenType::Greater, U"__greater"},
                 {ETokenType::GreaterEquel, U"__greater_equel"},
@@ -313,28 +387,6 @@ namespace LANG_NS
             return iter->second;
         }
 
-        SharedPtr<TokenT> Clone() const
-        {
-            SharedPtr<TokenT> token(new TokenT(_type, _line, _column));
-            if (_type == ETokenType::Bool)
-            {
-                token->_value.b = _value.b;
-            }
-            else if (_type == ETokenType::Int)
-            {
-                token->_value.i = _value.i;
-            }
-            else if (_type == ETokenType::Float)
-            {
-                token->_value.f = _value.f;
-            }
-            else if (_type == ETokenType::String || _type == ETokenType::Id)
-            {
-                *(token->_value.s) = *(_value.s);
-            }
-            return token;
-        }
-
     private:
         TokenT(const ETokenType t, SizeT line, SizeT column)
             : _type(t)
@@ -342,10 +394,12 @@ namespace LANG_NS
             , _column(column)
         {
             _value.i = 0;
-            if (_type == ETokenType::String || _type == ETokenType::Id)
-            {
-                _value.s = new StringT;
-            }
+        }
+
+        // tokens live in the arena of their compilation and are never freed one by one
+        static TokenT* Make(Arena& arena, const ETokenType t, SizeT line, SizeT column)
+        {
+            return new (arena.Allocate(sizeof(TokenT), alignof(TokenT))) TokenT(t, line, column);
         }
 
     private:
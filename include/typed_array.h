@@ -0,0 +1,489 @@
+#pragma once
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define LANG_TYPED_ARRAY_SSE2 1
+#endif
+#include <type_traits>
+#include "pre_define.h"
+#include "value.h"
+
+namespace LANG_NS
+{
+    // element-wise + - * / and reductions over int_array and float_array values
+    //  - a number on either side applies to every element, two arrays must have the same size
+    //  - ints stay ints, so / divides like it does on int numbers, anything with a float is done in floats
+    //  - float kernels and int + - run two elements at a time with sse2, int * / and int min max are plain loops
+    //  - float sums keep separate lanes, so the last bits may differ from adding the elements one by one
+    namespace TypedArray
+    {
+        enum class EOp
+        {
+            Add,
+            Sub,
+            Mul,
+            Div,
+        };
+
+        class AddOp
+        {
+        public:
+            static constexpr bool VectorInts = true;
+
+            template < typename T >
+            static T Do(T a, T b)
+            {
+                return a + b;
+            }
+
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            static __m128d Floats(__m128d a, __m128d b)
+            {
+                return _mm_add_pd(a, b);
+            }
+
+            static __m128i Ints(__m128i a, __m128i b)
+            {
+                return _mm_add_epi64(a, b);
+            }
+#endif
+        };
+
+        class SubOp
+        {
+        public:
+            static constexpr bool VectorInts = true;
+
+            template < typename T >
+            static T Do(T a, T b)
+            {
+                return a - b;
+            }
+
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            static __m128d Floats(__m128d a, __m128d b)
+            {
+                return _mm_sub_pd(a, b);
+            }
+
+            static __m128i Ints(__m128i a, __m128i b)
+            {
+                return _mm_sub_epi64(a, b);
+            }
+#endif
+        };
+
+        // sse2 has no 64 bit int multiply or divide
+        class MulOp
+        {
+        public:
+            static constexpr bool VectorInts = false;
+
+            template < typename T >
+            static T Do(T a, T b)
+            {
+                return a * b;
+            }
+
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            static __m128d Floats(__m128d a, __m128d b)
+            {
+                return _mm_mul_pd(a, b);
+            }
+#endif
+        };
+
+        class DivOp
+        {
+        public:
+            static constexpr bool VectorInts = false;
+
+            template < typename T >
+            static T Do(T a, T b)
+            {
+                return a / b;
+            }
+
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            static __m128d Floats(__m128d a, __m128d b)
+            {
+                return _mm_div_pd(a, b);
+            }
+#endif
+        };
+
+        template < typename T >
+        static constexpr Value::EType ArrayType()
+        {
+            return std::is_same<T, IntT>::value ? Value::EType::IntArray : Value::EType::FloatArray;
+        }
+
+        // out may be l or r, a scalar side points at its one element
+        template < typename Op, typename T, bool LeftScalar, bool RightScalar >
+        static void Apply(const T* l, const T* r, T* out, SizeT size)
+        {
+            SizeT i = 0;
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            if constexpr (std::is_same<T, FloatT>::value)
+            {
+                const auto lv = LeftScalar ? _mm_set1_pd(*l) : _mm_setzero_pd();
+                const auto rv = RightScalar ? _mm_set1_pd(*r) : _mm_setzero_pd();
+                for (; i + 2 <= size; i += 2)
+                {
+                    auto a = LeftScalar ? lv : _mm_loadu_pd(l + i);
+                    auto b = RightScalar ? rv : _mm_loadu_pd(r + i);
+                    _mm_storeu_pd(out + i, Op::Floats(a, b));
+                }
+            }
+            else if constexpr (Op::VectorInts)
+            {
+                const auto lv = LeftScalar ? _mm_set1_epi64x(*l) : _mm_setzero_si128();
+                const auto rv = RightScalar ? _mm_set1_epi64x(*r) : _mm_setzero_si128();
+                for (; i + 2 <= size; i += 2)
+                {
+                    auto a = LeftScalar ? lv : _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i));
+                    auto b = RightScalar ? rv : _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), Op::Ints(a, b));
+                }
+            }
+#endif
+            for (; i < size; ++i)
+            {
+                out[i] = Op::template Do<T>(l[LeftScalar ? 0 : i], r[RightScalar ? 0 : i]);
+            }
+        }
+
+        template < typename Op, typename T >
+        static void Apply(const T* l, bool l_scalar, const T* r, bool r_scalar, T* out, SizeT size)
+        {
+            if (l_scalar)
+            {
+                Apply<Op, T, true, false>(l, r, out, size);
+            }
+            else if (r_scalar)
+            {
+                Apply<Op, T, false, true>(l, r, out, size);
+            }
+            else
+            {
+                Apply<Op, T, false, false>(l, r, out, size);
+            }
+        }
+
+        // the elements of an operand as T, a number is one element and an int array read as floats is widened into temp
+        template < typename T >
+        static const T* Elements(const ValuePtr& v, T& number, TVector<T>& temp)
+        {
+            switch (v->GetType())
+            {
+            case Value::EType::Int:
+                number = static_cast<T>(v->IntValue());
+                return &number;
+            case Value::EType::Float:
+                number = static_cast<T>(v->FloatValue());
+                return &number;
+            case Value::EType::IntArray:
+                if constexpr (std::is_same<T, IntT>::value)
+                {
+                    return v->IntArrayValue().data();
+                }
+                else
+                {
+                    temp.assign(v->IntArrayValue().begin(), v->IntArrayValue().end());
+                    return temp.data();
+                }
+            default:
+                if constexpr (std::is_same<T, FloatT>::value)
+                {
+                    return v->FloatArrayValue().data();
+                }
+                else
+                {
+                    return nullptr;
+                }
+            }
+        }
+
+        // the buffer of an operand that is also the result and that nothing else holds, else nullptr
+        template < typename T >
+        static T* Reusable(const ValuePtr& operand, ValuePtr& result)
+        {
+            if (&operand != &result || result->GetType() != ArrayType<T>() || !result->UniquelyHeld())
+            {
+                return nullptr;
+            }
+            if constexpr (std::is_same<T, IntT>::value)
+            {
+                return result->IntArrayValue().data();
+            }
+            else
+            {
+                return result->FloatArrayValue().data();
+            }
+        }
+
+        template < typename T >
+        static void ElementWiseAs(EOp op, const ValuePtr& left, const ValuePtr& right, ValuePtr& result, SizeT size)
+        {
+            T left_number = 0;
+            T right_number = 0;
+            TVector<T> left_temp;
+            TVector<T> right_temp;
+            auto l = Elements<T>(left, left_number, left_temp);
+            auto r = Elements<T>(right, right_number, right_temp);
+            bool l_scalar = !left->IsTypedArray();
+            bool r_scalar = !right->IsTypedArray();
+            if constexpr (std::is_same<T, IntT>::value)
+            {
+                if (op == EOp::Div && std::find(r, r + (r_scalar ? 1 : size), 0) != r + (r_scalar ? 1 : size))
+                {
+                    throw(Exception(U"Typed array divided by zero"));
+                }
+            }
+
+            // r = r op x reuses the buffer of r when nothing else holds it
+            TVector<T> fresh;
+            auto out = Reusable<T>(left, result);
+            if (!out)
+            {
+                out = Reusable<T>(right, result);
+            }
+            if (!out)
+            {
+                fresh.resize(size);
+                out = fresh.data();
+            }
+            switch (op)
+            {
+            case EOp::Add:
+                Apply<AddOp, T>(l, l_scalar, r, r_scalar, out, size);
+                break;
+            case EOp::Sub:
+                Apply<SubOp, T>(l, l_scalar, r, r_scalar, out, size);
+                break;
+            case EOp::Mul:
+                Apply<MulOp, T>(l, l_scalar, r, r_scalar, out, size);
+                break;
+            case EOp::Div:
+                Apply<DivOp, T>(l, l_scalar, r, r_scalar, out, size);
+                break;
+            }
+            if (out == fresh.data())
+            {
+                result = ValueData(std::move(fresh));
+            }
+        }
+
+        static bool IsOperand(Value::EType t)
+        {
+            return t == Value::EType::Int
+                || t == Value::EType::Float
+                || t == Value::EType::IntArray
+                || t == Value::EType::FloatArray;
+        }
+
+        // result = left op right where one side at least is a typed array
+        static void ElementWise(EOp op, const ValuePtr& left, const ValuePtr& right, ValuePtr& result)
+        {
+            auto left_type = left->GetType();
+            auto right_type = right->GetType();
+            Assert(left->IsTypedArray() || right->IsTypedArray());
+            if (!IsOperand(left_type) || !IsOperand(right_type))
+            {
+                throw(Exception(U"Typed array operand must be a number or a typed array"));
+            }
+            if (left->IsTypedArray() && right->IsTypedArray() && left->TypedArraySize() != right->TypedArraySize())
+            {
+                throw(Exception(U"Typed arrays must have the same size"));
+            }
+            auto size = left->IsTypedArray() ? left->TypedArraySize() : right->TypedArraySize();
+            if (
+                left_type == Value::EType::Float
+                || left_type == Value::EType::FloatArray
+                || right_type == Value::EType::Float
+                || right_type == Value::EType::FloatArray
+            )
+            {
+                ElementWiseAs<FloatT>(op, left, right, result, size);
+            }
+            else
+            {
+                ElementWiseAs<IntT>(op, left, right, result, size);
+            }
+        }
+
+        static FloatT SumFloats(const FloatT* p, SizeT size)
+        {
+            SizeT i = 0;
+            FloatT sum = 0;
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            auto a = _mm_setzero_pd();
+            auto b = _mm_setzero_pd();
+            for (; i + 4 <= size; i += 4)
+            {
+                a = _mm_add_pd(a, _mm_loadu_pd(p + i));
+                b = _mm_add_pd(b, _mm_loadu_pd(p + i + 2));
+            }
+            FloatT lanes[2];
+            _mm_storeu_pd(lanes, _mm_add_pd(a, b));
+            sum = lanes[0] + lanes[1];
+#endif
+            for (; i < size; ++i)
+            {
+                sum += p[i];
+            }
+            return sum;
+        }
+
+        static IntT SumInts(const IntT* p, SizeT size)
+        {
+            SizeT i = 0;
+            IntT sum = 0;
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            auto a = _mm_setzero_si128();
+            auto b = _mm_setzero_si128();
+            for (; i + 4 <= size; i += 4)
+            {
+                a = _mm_add_epi64(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+                b = _mm_add_epi64(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 2)));
+            }
+            IntT lanes[2];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(a, b));
+            sum = lanes[0] + lanes[1];
+#endif
+            for (; i < size; ++i)
+            {
+                sum += p[i];
+            }
+            return sum;
+        }
+
+        static FloatT DotFloats(const FloatT* l, const FloatT* r, SizeT size)
+        {
+            SizeT i = 0;
+            FloatT sum = 0;
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            auto a = _mm_setzero_pd();
+            auto b = _mm_setzero_pd();
+            for (; i + 4 <= size; i += 4)
+            {
+                a = _mm_add_pd(a, _mm_mul_pd(_mm_loadu_pd(l + i), _mm_loadu_pd(r + i)));
+                b = _mm_add_pd(b, _mm_mul_pd(_mm_loadu_pd(l + i + 2), _mm_loadu_pd(r + i + 2)));
+            }
+            FloatT lanes[2];
+            _mm_storeu_pd(lanes, _mm_add_pd(a, b));
+            sum = lanes[0] + lanes[1];
+#endif
+            for (; i < size; ++i)
+            {
+                sum += l[i] * r[i];
+            }
+            return sum;
+        }
+
+        static IntT DotInts(const IntT* l, const IntT* r, SizeT size)
+        {
+            IntT sum = 0;
+            for (SizeT i = 0; i < size; ++i)
+            {
+                sum += l[i] * r[i];
+            }
+            return sum;
+        }
+
+        template < bool Max, typename T >
+        static T Pick(T best, T v)
+        {
+            return (Max ? v > best : v < best) ? v : best;
+        }
+
+        // size must not be 0
+        template < bool Max >
+        static FloatT ExtremeFloats(const FloatT* p, SizeT size)
+        {
+            SizeT i = 1;
+            FloatT best = p[0];
+#if defined(LANG_TYPED_ARRAY_SSE2)
+            if (size >= 2)
+            {
+                auto acc = _mm_loadu_pd(p);
+                for (i = 2; i + 2 <= size; i += 2)
+                {
+                    auto v = _mm_loadu_pd(p + i);
+                    acc = Max ? _mm_max_pd(acc, v) : _mm_min_pd(acc, v);
+                }
+                FloatT lanes[2];
+                _mm_storeu_pd(lanes, acc);
+                best = Pick<Max>(lanes[0], lanes[1]);
+            }
+#endif
+            for (; i < size; ++i)
+            {
+                best = Pick<Max>(best, p[i]);
+            }
+            return best;
+        }
+
+        template < bool Max >
+        static IntT ExtremeInts(const IntT* p, SizeT size)
+        {
+            IntT best = p[0];
+            for (SizeT i = 1; i < size; ++i)
+            {
+                best = Pick<Max>(best, p[i]);
+            }
+            return best;
+        }
+
+        static ValuePtr Sum(const ValuePtr& v)
+        {
+            if (v->GetType() == Value::EType::IntArray)
+            {
+                auto& data = v->IntArrayValue();
+                return Value::New(SumInts(data.data(), data.size()));
+            }
+            auto& data = v->FloatArrayValue();
+            return Value::New(SumFloats(data.data(), data.size()));
+        }
+
+        // nil for an empty array
+        template < bool Max >
+        static ValuePtr Extreme(const ValuePtr& v)
+        {
+            if (v->TypedArraySize() == 0)
+            {
+                return Value::New();
+            }
+            if (v->GetType() == Value::EType::IntArray)
+            {
+                auto& data = v->IntArrayValue();
+                return Value::New(ExtremeInts<Max>(data.data(), data.size()));
+            }
+            auto& data = v->FloatArrayValue();
+            return Value::New(ExtremeFloats<Max>(data.data(), data.size()));
+        }
+
+        static ValuePtr Dot(const ValuePtr& left, const ValuePtr& right)
+        {
+            if (!right->IsTypedArray())
+            {
+                throw(Exception(U"Typed array dot needs a typed array"));
+            }
+            if (left->TypedArraySize() != right->TypedArraySize())
+            {
+                throw(Exception(U"Typed arrays must have the same size"));
+            }
+            auto size = left->TypedArraySize();
+            if (left->GetType() == Value::EType::IntArray && right->GetType() == Value::EType::IntArray)
+            {
+                return Value::New(DotInts(left->IntArrayValue().data(), right->IntArrayValue().data(), size));
+            }
+            FloatT left_number = 0;
+            FloatT right_number = 0;
+            TVector<FloatT> left_temp;
+            TVector<FloatT> right_temp;
+            auto l = Elements<FloatT>(left, left_number, left_temp);
+            auto r = Elements<FloatT>(right, right_number, right_temp);
+            return Value::New(DotFloats(l, r, size));
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <sstream>
 #include "unicode_helper.h"
+#include "unicode_transcoder.h"
 
 namespace LANG_NS
 {
@@ -23,11 +24,26 @@ namespace LANG_NS
 
         static StringT __ANSIToUcs4(const BytesT& src)
         {
-            Helper::SetLocale();
+            // ascii is the same in every locale
+            if (Transcoder::AsciiPrefix(src.data(), src.size()) == src.size())
+            {
+                StringT dst;
+                dst.resize(src.size());
+                Transcoder::WidenAscii(src.data(), src.size(), &dst[0]);
+                return dst;
+            }
+            if (Helper::IsUtf8Locale())
+            {
+                return Transcoder::Utf8ToUcs4(src, false);
+            }
             const char* src_str = src.data();
             std::mbstate_t state;
             memset(&state, 0, sizeof(std::mbstate_t));
             size_t len = std::mbsrtowcs(nullptr, &src_str, 0, &state);
+            if (len == static_cast<size_t>(-1))
+            {
+                throw(Exception(U"Invalid character"));
+            }
             std::wstring dst;
             dst.resize(len);
             std::mbsrtowcs(dst.data(), &src_str, len, &state);
@@ -36,35 +52,17 @@ namespace LANG_NS
 
         static StringT __Utf8ToUcs4(const BytesT& src, bool without_bom)
         {
-            if (without_bom)
-            {
-                auto& converter = Helper::ConverterUtf8WithoutBOM();
-                return converter.from_bytes(src.c_str(), src.c_str() + src.size());
-            }
-            auto& converter = Helper::ConverterUtf8();
-            return converter.from_bytes(src.c_str(), src.c_str() + src.size());
+            return Transcoder::Utf8ToUcs4(src, !without_bom);
         }
 
         static StringT __Utf16LEToUcs4(const BytesT& src, bool without_bom)
         {
-            if (without_bom)
-            {
-                auto& converter = Helper::ConverterUtf16LEWithoutBOM();
-                return converter.from_bytes(src.c_str(), src.c_str() + src.size());
-            }
-            auto& converter = Helper::ConverterUtf16LE();
-            return converter.from_bytes(src.c_str(), src.c_str() + src.size());
+            return Transcoder::Utf16ToUcs4(src, true, !without_bom);
         }
 
         static StringT __Utf16BEToUcs4(const BytesT& src, bool without_bom)
         {
-            if (without_bom)
-            {
-                auto& converter = Helper::ConverterUtf16BEWithoutBOM();
-                return converter.from_bytes(src.c_str(), src.c_str() + src.size());
-            }
-            auto& converter = Helper::ConverterUtf16BE();
-            return converter.from_bytes(src.c_str(), src.c_str() + src.size());
+            return Transcoder::Utf16ToUcs4(src, false, !without_bom);
         }
 
         static StringT __Utf32LEToUcs4(const BytesT& src, bool without_bom)
@@ -119,7 +117,17 @@ namespace LANG_NS
 
         static BytesT __Ucs4ToANSI(const StringT& src)
         {
-            Helper::SetLocale();
+            if (Transcoder::AsciiPrefix(src.data(), src.size()) == src.size())
+            {
+                BytesT dst;
+                dst.resize(src.size());
+                Transcoder::NarrowAscii(src.data(), src.size(), &dst[0]);
+                return dst;
+            }
+            if (Helper::IsUtf8Locale())
+            {
+                return Transcoder::Ucs4ToUtf8(src, false);
+            }
             std::wstring src_wstr = __Ucs4ToWstring(src);
             size_t len = std::wcstombs(nullptr, src_wstr.data(), 0);
             if (len == static_cast<size_t>(-1))
@@ -135,35 +143,17 @@ namespace LANG_NS
 
         static BytesT __Ucs4ToUtf8(const StringT& src, bool generate_bom)
         {
-            if (!generate_bom)
-            {
-                auto& converter = Helper::ConverterUtf8WithoutBOM();
-                return converter.to_bytes(src);
-            }
-            auto& converter = Helper::ConverterUtf8();
-            return converter.to_bytes(src);
+            return Transcoder::Ucs4ToUtf8(src, generate_bom);
         }
 
         static BytesT __Ucs4ToUtf16LE(const StringT& src, bool generate_bom)
         {
-            if (!generate_bom)
-            {
-                auto& converter = Helper::ConverterUtf16LEWithoutBOM();
-                return converter.to_bytes(src);
-            }
-            auto& converter = Helper::ConverterUtf16LE();
-            return converter.to_bytes(src);
+            return Transcoder::Ucs4ToUtf16(src, true, generate_bom);
         }
 
         static BytesT __Ucs4ToUtf16BE(const StringT& src, bool generate_bom)
         {
-            if (!generate_bom)
-            {
-                auto& converter = Helper::ConverterUtf16BEWithoutBOM();
-                return converter.to_bytes(src);
-            }
-            auto& converter = Helper::ConverterUtf16BE();
-            return converter.to_bytes(src);
+            return Transcoder::Ucs4ToUtf16(src, false, generate_bom);
         }
 
         static BytesT __Ucs4ToUtf32LE(const StringT& src, bool generate_bom)
@@ -242,7 +232,8 @@ namespace LANG_NS
                             break;
                         }
                     }
-                    if (src.size() % 2 == 0)
+                    // an odd length after a utf-16 bom is broken utf-16, not ansi, the transcoder rejects it
+                    if (src.size() >= 2)
                     {
                         if (src[0] == '\xFF' && src[1] == '\xFE')
                         {
@@ -333,26 +324,12 @@ namespace LANG_NS
 
         static bool IsDigit(CharT c)
         {
-            if (
-                c == '0' || c == '1' || c == '2' || c == '3' || c == '4'
-                || c == '5' || c == '6' || c == '7' || c == '8' || c == '9'
-                )
-            {
-                return true;
-            }
-            return Helper::InCharCheckList(Helper::DigitTable(), c);
+            return Helper::IsDigit(c);
         }
 
         static bool IsLetter(CharT c)
         {
-            if (
-                (c >= 'a' && c <= 'z')
-                || (c >= 'A' && c <= 'Z')
-                )
-            {
-                return true;
-            }
-            return Helper::InCharCheckList(Helper::LetterTable(), c);
+            return Helper::IsLetter(c);
         }
     }
     template < typename T >
@@ -1,5 +1,11 @@
 #pragma once
 #include <fstream>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "unicode.h"
 
 namespace LANG_NS
@@ -9,7 +15,9 @@ namespace LANG_NS
         class ReaderBase
         {
         public:
-            Option<CharT> Read()
+            virtual ~ReaderBase() {}
+
+            virtual Option<CharT> Read()
             {
                 if (_pos >= _str.size())
                 {
@@ -44,23 +52,211 @@ namespace LANG_NS
             }
         };
 
+        // a regular file mapped read only, empty when the file cannot be mapped
+        class MappedFile : NoCopyable
+        {
+        public:
+            explicit MappedFile(const BytesT& file_name)
+            {
+#if defined(__linux__)
+                auto fd = open(file_name.c_str(), O_RDONLY);
+                if (fd < 0)
+                {
+                    return;
+                }
+                struct stat st;
+                if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+                {
+                    auto data = mmap(nullptr, static_cast<SizeT>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (data != MAP_FAILED)
+                    {
+                        (void)madvise(data, static_cast<SizeT>(st.st_size), MADV_SEQUENTIAL);
+                        _data = static_cast<const ByteT*>(data);
+                        _size = static_cast<SizeT>(st.st_size);
+                    }
+                }
+                close(fd);
+#endif
+            }
+
+            ~MappedFile()
+            {
+#if defined(__linux__)
+                if (_data)
+                {
+                    munmap(const_cast<ByteT*>(_data), _size);
+                }
+#endif
+            }
+
+            const ByteT* Data() const
+            {
+                return _data;
+            }
+
+            SizeT Size() const
+            {
+                return _size;
+            }
+
+        private:
+            const ByteT* _data = nullptr;
+            SizeT _size = 0;
+        };
+
+        // utf-8 and ansi files are decoded one character at a time, other formats are decoded up front
+        //  - regular files are mapped and read in place
+        //  - anything else, like a pipe, is read in chunks
         class FileReader : public ReaderBase
         {
         public:
             explicit FileReader(const StringT& file_name, Unicode::FormatType format_type = Unicode::FormatType::Auto, bool without_bom = true)
+                : _mapped(Unicode::Encode(file_name, Unicode::FormatType::ANSI))
             {
-                std::ifstream ifs(Unicode::Encode(file_name, Unicode::FormatType::ANSI), std::ios_base::in | std::ios_base::binary);
-                BytesT str(
-                    (std::istreambuf_iterator<char>(ifs)),
-                    std::istreambuf_iterator<char>()
-                );
-                if (0 == str.find(Utf8CodingTag))
+                _module_name = file_name;
+                if (_mapped.Data())
                 {
-                    format_type = FormatType::Utf8;
+                    _data = _mapped.Data();
+                    _size = _mapped.Size();
                 }
-                _str = Unicode::Decode(str, format_type, without_bom);
-                _module_name = file_name;
+                else
+                {
+                    _ifs.open(Unicode::Encode(file_name, Unicode::FormatType::ANSI), std::ios_base::in | std::ios_base::binary);
+                    Fill();
+                }
+                if (format_type == FormatType::Auto)
+                {
+                    if (StartsWith(Utf8CodingTag))
+                    {
+                        format_type = FormatType::Utf8;
+                    }
+                    else if (StartsWith(Utf8Bom))
+                    {
+                        format_type = FormatType::Utf8;
+                        without_bom = false;
+                    }
+                    else if (!StartsWith("\xFF\xFE") && !StartsWith("\xFE\xFF") && !StartsWith(BytesT("\0\0\xFE\xFF", 4)))
+                    {
+                        format_type = FormatType::ANSI;
+                    }
+                }
+                _format_type = format_type;
+                if (_format_type == FormatType::Utf8 && !without_bom && StartsWith(Utf8Bom))
+                {
+                    _byte_pos = Utf8Bom.size();
+                }
+                else if (_format_type != FormatType::Utf8 && (_format_type != FormatType::ANSI || sizeof(wchar_t) != 4))
+                {
+                    ReadAll(without_bom);
+                }
+                Helper::SetLocale();
+                memset(&_state, 0, sizeof(std::mbstate_t));
+            }
+
+            Option<CharT> Read() override
+            {
+                if (_lazy == false)
+                {
+                    return ReaderBase::Read();
+                }
+                if (_byte_pos + Utf8MaxSize > _size)
+                {
+                    Fill();
+                    if (_byte_pos >= _size)
+                    {
+                        return Option<CharT>();
+                    }
+                }
+                auto lead = static_cast<unsigned char>(_data[_byte_pos]);
+                if (lead < 0x80)
+                {
+                    ++_byte_pos;
+                    return static_cast<CharT>(lead);
+                }
+                return _format_type == FormatType::Utf8 ? ReadUtf8(lead) : ReadANSI();
+            }
+
+        private:
+            static constexpr SizeT ChunkSize = 64 * 1024;
+
+            bool StartsWith(const BytesT& prefix) const
+            {
+                return _size >= prefix.size() && memcmp(_data, prefix.data(), prefix.size()) == 0;
             }
+
+            // keeps the bytes not read yet and appends the next chunk of the stream
+            void Fill()
+            {
+                if (!_ifs.is_open())
+                {
+                    return;
+                }
+                _bytes.erase(0, _byte_pos);
+                _byte_pos = 0;
+                if (_ifs)
+                {
+                    auto size = _bytes.size();
+                    _bytes.resize(size + ChunkSize);
+                    _ifs.read(&_bytes[size], ChunkSize);
+                    _bytes.resize(size + static_cast<SizeT>(_ifs.gcount()));
+                }
+                _data = _bytes.data();
+                _size = _bytes.size();
+            }
+
+            void ReadAll(bool without_bom)
+            {
+                if (_ifs.is_open())
+                {
+                    _bytes.append((std::istreambuf_iterator<char>(_ifs)), std::istreambuf_iterator<char>());
+                    _data = _bytes.data();
+                    _size = _bytes.size();
+                }
+                _str = Unicode::Decode(_size > 0 ? BytesT(_data, _size) : BytesT(), _format_type, without_bom);
+                _bytes.clear();
+                _data = nullptr;
+                _size = 0;
+                _lazy = false;
+            }
+
+            // same rules as Transcoder::Utf8ToUcs4, so a file decodes like the same bytes in a string
+            CharT ReadUtf8(unsigned char lead)
+            {
+                auto size = Transcoder::Utf8SequenceLength(lead);
+                CharT c = 0;
+                if (size == 0 || _byte_pos + size > _size || !Transcoder::DecodeUtf8Sequence(_data + _byte_pos, size, c))
+                {
+                    throw(Exception(StringT(U"Invalid utf-8 sequence in ") + _module_name));
+                }
+                _byte_pos += size;
+                return c;
+            }
+
+            // the locale decides the encoding, as in Unicode::Decode
+            CharT ReadANSI()
+            {
+                wchar_t c = 0;
+                auto size = std::mbrtowc(&c, _data + _byte_pos, _size - _byte_pos, &_state);
+                if (size == static_cast<size_t>(-1) || size == static_cast<size_t>(-2))
+                {
+                    throw(Exception(StringT(U"Invalid character in ") + _module_name));
+                }
+                _byte_pos += size == 0 ? 1 : size;
+                return static_cast<CharT>(c);
+            }
+
+        private:
+            static inline const BytesT Utf8Bom = "\xEF\xBB\xBF";
+            MappedFile _mapped;
+            std::ifstream _ifs;
+            FormatType _format_type = FormatType::Auto;
+            std::mbstate_t _state;
+            // bytes being decoded, the mapped file or the buffer of the stream
+            const ByteT* _data = nullptr;
+            SizeT _size = 0;
+            SizeT _byte_pos = 0;
+            BytesT _bytes;
+            bool _lazy = true;
         };
     }
 }
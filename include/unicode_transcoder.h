@@ -0,0 +1,313 @@
+#pragma once
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define LANG_UNICODE_SSE2 1
+#endif
+#include "pre_define.h"
+
+namespace LANG_NS
+{
+    namespace Unicode
+    {
+        // utf-8 and utf-16 to and from ucs-4 without codecvt
+        //  - runs of ascii are checked and widened or narrowed 16 characters at a time with sse2
+        //  - everything else goes through the scalar loops, which reject malformed input
+        namespace Transcoder
+        {
+            static const BytesT Utf8Bom = "\xEF\xBB\xBF";
+
+            // number of leading bytes below 0x80
+            static SizeT AsciiPrefix(const ByteT* src, SizeT size)
+            {
+                SizeT i = 0;
+#if defined(LANG_UNICODE_SSE2)
+                for (; i + 16 <= size; i += 16)
+                {
+                    auto mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+                    if (mask != 0)
+                    {
+                        return i + static_cast<SizeT>(__builtin_ctz(static_cast<unsigned>(mask)));
+                    }
+                }
+#endif
+                while (i < size && static_cast<unsigned char>(src[i]) < 0x80)
+                {
+                    ++i;
+                }
+                return i;
+            }
+
+            // number of leading characters below 0x80
+            static SizeT AsciiPrefix(const CharT* src, SizeT size)
+            {
+                SizeT i = 0;
+#if defined(LANG_UNICODE_SSE2)
+                const auto high = _mm_set1_epi32(~0x7F);
+                const auto zero = _mm_setzero_si128();
+                for (; i + 4 <= size; i += 4)
+                {
+                    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, high), zero)) != 0xFFFF)
+                    {
+                        break;
+                    }
+                }
+#endif
+                while (i < size && src[i] < 0x80)
+                {
+                    ++i;
+                }
+                return i;
+            }
+
+            static void WidenAscii(const ByteT* src, SizeT size, CharT* dst)
+            {
+                SizeT i = 0;
+#if defined(LANG_UNICODE_SSE2)
+                const auto zero = _mm_setzero_si128();
+                for (; i + 16 <= size; i += 16)
+                {
+                    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                    auto lo = _mm_unpacklo_epi8(v, zero);
+                    auto hi = _mm_unpackhi_epi8(v, zero);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(lo, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+                }
+#endif
+                for (; i < size; ++i)
+                {
+                    dst[i] = static_cast<unsigned char>(src[i]);
+                }
+            }
+
+            // every character must be below 0x80
+            static void NarrowAscii(const CharT* src, SizeT size, ByteT* dst)
+            {
+                SizeT i = 0;
+#if defined(LANG_UNICODE_SSE2)
+                for (; i + 16 <= size; i += 16)
+                {
+                    auto a = _mm_packs_epi32(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4))
+                    );
+                    auto b = _mm_packs_epi32(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8)),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12))
+                    );
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+                }
+#endif
+                for (; i < size; ++i)
+                {
+                    dst[i] = static_cast<ByteT>(src[i]);
+                }
+            }
+
+            static bool IsValidCodePoint(CharT c)
+            {
+                return c <= 0x10FFFF && (c < 0xD800 || c > 0xDFFF);
+            }
+
+            // bytes of the utf-8 sequence a lead byte starts, 0 for a byte that cannot start one
+            //  - c0 and c1 only start overlong 2 byte forms, f5 and up only values past 0x10FFFF
+            static SizeT Utf8SequenceLength(unsigned char lead)
+            {
+                return lead > 0xF4 ? 0 : lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC2 ? 2 : 0;
+            }
+
+            // decodes the sequence of length bytes at src, false if it is malformed
+            static bool DecodeUtf8Sequence(const ByteT* src, SizeT length, CharT& c)
+            {
+                c = static_cast<unsigned char>(src[0]) & (0x7F >> length);
+                for (SizeT k = 1; k < length; ++k)
+                {
+                    auto byte = static_cast<unsigned char>(src[k]);
+                    if ((byte & 0xC0) != 0x80)
+                    {
+                        return false;
+                    }
+                    c = (c << 6) | (byte & 0x3F);
+                }
+                // overlong forms, surrogates and values past 0x10FFFF
+                return !((length == 3 && c < 0x800) || (length == 4 && c < 0x10000) || !IsValidCodePoint(c));
+            }
+
+            // consume_bom skips a leading byte order mark
+            static StringT Utf8ToUcs4(const BytesT& src, bool consume_bom)
+            {
+                const auto size = src.size();
+                SizeT i = consume_bom && src.compare(0, Utf8Bom.size(), Utf8Bom) == 0 ? Utf8Bom.size() : 0;
+                StringT dst;
+                dst.resize(size - i);
+                SizeT n = 0;
+                while (i < size)
+                {
+                    auto ascii = AsciiPrefix(src.data() + i, size - i);
+                    WidenAscii(src.data() + i, ascii, &dst[n]);
+                    i += ascii;
+                    n += ascii;
+                    if (i >= size)
+                    {
+                        break;
+                    }
+                    auto length = Utf8SequenceLength(static_cast<unsigned char>(src[i]));
+                    CharT c = 0;
+                    if (length == 0 || i + length > size || !DecodeUtf8Sequence(src.data() + i, length, c))
+                    {
+                        throw(Exception(U"Invalid utf-8 sequence"));
+                    }
+                    dst[n++] = c;
+                    i += length;
+                }
+                dst.resize(n);
+                return dst;
+            }
+
+            static BytesT Ucs4ToUtf8(const StringT& src, bool generate_bom)
+            {
+                const auto size = src.size();
+                BytesT dst;
+                dst.resize((generate_bom ? Utf8Bom.size() : 0) + size * 4);
+                SizeT n = 0;
+                if (generate_bom)
+                {
+                    n = Utf8Bom.copy(&dst[0], Utf8Bom.size());
+                }
+                SizeT i = 0;
+                while (i < size)
+                {
+                    auto ascii = AsciiPrefix(src.data() + i, size - i);
+                    NarrowAscii(src.data() + i, ascii, &dst[n]);
+                    i += ascii;
+                    n += ascii;
+                    if (i >= size)
+                    {
+                        break;
+                    }
+                    auto c = src[i++];
+                    if (!IsValidCodePoint(c))
+                    {
+                        throw(Exception(U"Invalid character, cannot convert to utf-8"));
+                    }
+                    if (c < 0x800)
+                    {
+                        dst[n++] = static_cast<ByteT>(0xC0 | (c >> 6));
+                    }
+                    else if (c < 0x10000)
+                    {
+                        dst[n++] = static_cast<ByteT>(0xE0 | (c >> 12));
+                        dst[n++] = static_cast<ByteT>(0x80 | ((c >> 6) & 0x3F));
+                    }
+                    else
+                    {
+                        dst[n++] = static_cast<ByteT>(0xF0 | (c >> 18));
+                        dst[n++] = static_cast<ByteT>(0x80 | ((c >> 12) & 0x3F));
+                        dst[n++] = static_cast<ByteT>(0x80 | ((c >> 6) & 0x3F));
+                    }
+                    dst[n++] = static_cast<ByteT>(0x80 | (c & 0x3F));
+                }
+                dst.resize(n);
+                return dst;
+            }
+
+            // consume_bom reads a leading byte order mark, which also picks the byte order
+            static StringT Utf16ToUcs4(const BytesT& src, bool little_endian, bool consume_bom)
+            {
+                if (src.size() % 2 != 0)
+                {
+                    throw(Exception(U"Invalid utf-16 sequence"));
+                }
+                auto bytes = reinterpret_cast<const unsigned char*>(src.data());
+                const auto size = src.size() / 2;
+                SizeT i = 0;
+                if (consume_bom && size > 0)
+                {
+                    if (bytes[0] == 0xFF && bytes[1] == 0xFE)
+                    {
+                        little_endian = true;
+                        i = 1;
+                    }
+                    else if (bytes[0] == 0xFE && bytes[1] == 0xFF)
+                    {
+                        little_endian = false;
+                        i = 1;
+                    }
+                }
+                auto unit = [&](SizeT index) -> CharT
+                {
+                    return little_endian
+                        ? bytes[index * 2] | (bytes[index * 2 + 1] << 8)
+                        : (bytes[index * 2] << 8) | bytes[index * 2 + 1];
+                };
+                StringT dst;
+                dst.resize(size - i);
+                SizeT n = 0;
+                while (i < size)
+                {
+                    auto c = unit(i++);
+                    if (c >= 0xD800 && c <= 0xDBFF)
+                    {
+                        CharT low = i < size ? unit(i) : 0;
+                        if (low < 0xDC00 || low > 0xDFFF)
+                        {
+                            throw(Exception(U"Invalid utf-16 sequence"));
+                        }
+                        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                        ++i;
+                    }
+                    else if (c >= 0xDC00 && c <= 0xDFFF)
+                    {
+                        throw(Exception(U"Invalid utf-16 sequence"));
+                    }
+                    dst[n++] = c;
+                }
+                dst.resize(n);
+                return dst;
+            }
+
+            static BytesT Ucs4ToUtf16(const StringT& src, bool little_endian, bool generate_bom)
+            {
+                BytesT dst;
+                dst.reserve((src.size() + 1) * 2);
+                auto put = [&](CharT unit)
+                {
+                    if (little_endian)
+                    {
+                        dst.push_back(static_cast<ByteT>(unit & 0xFF));
+                        dst.push_back(static_cast<ByteT>(unit >> 8));
+                    }
+                    else
+                    {
+                        dst.push_back(static_cast<ByteT>(unit >> 8));
+                        dst.push_back(static_cast<ByteT>(unit & 0xFF));
+                    }
+                };
+                if (generate_bom)
+                {
+                    put(0xFEFF);
+                }
+                for (auto iter = src.begin(); iter != src.end(); ++iter)
+                {
+                    auto c = *iter;
+                    if (!IsValidCodePoint(c))
+                    {
+                        throw(Exception(U"Invalid character, cannot convert to utf-16"));
+                    }
+                    if (c < 0x10000)
+                    {
+                        put(c);
+                    }
+                    else
+                    {
+                        put(0xD800 + ((c - 0x10000) >> 10));
+                        put(0xDC00 + ((c - 0x10000) & 0x3FF));
+                    }
+                }
+                return dst;
+            }
+        }
+    }
+}
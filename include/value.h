@@ -1,4 +1,5 @@
 #pragma once
+#include "hash_dict.h"
 #include "pre_define.h"
 #include "token.h"
 
@@ -17,6 +18,9 @@ namespace LANG_NS
             Array,
             Dict,
             Function,
+            IntArray,
+            FloatArray,
+            Range,
         };
 
         static StringT TypeString(EType t)
@@ -30,6 +34,9 @@ namespace LANG_NS
                 {EType::Array, U"array"},
                 {EType::Dict, U"dict"},
                 {EType::Function, U"func"},
+                {EType::IntArray, U"int_array"},
+                {EType::FloatArray, U"float_array"},
+                {EType::Range, U"range"},
             };
             auto iter = _type_strs.find(t);
             if (iter == _type_strs.end())
@@ -40,12 +47,256 @@ namespace LANG_NS
         }
 
         class Data;
-        using ValuePtr = SharedPtr<Value::Data>;
+        // values are held in place, a value is its own handle
+        using ValuePtr = Value::Data;
         using ValuePtrList = TVector<ValuePtr>;
         using ArrayT = TVector<ValuePtr>;
-        using DictT = TMap<Value::Data, ValuePtr>;
+        using DictT = HashDict<Value::Data, ValuePtr>;
         using FunctionT = std::function<ValuePtrList(EnvironmentInterface&, const ValuePtrList&)>;
+        // packed numbers, one element type per array
+        using IntArrayT = TVector<IntT>;
+        using FloatArrayT = TVector<FloatT>;
 
+        // the numbers range(...) stands for, they are made one at a time as they are asked for
+        class RangeT
+        {
+        public:
+            union Number {
+                IntT i;
+                FloatT f;
+            };
+
+            bool interger = true;
+            Number begin = {0};
+            Number end = {0};
+            Number interval = {0};
+        };
+
+        // heap part of strings, arrays, dicts and functions
+        // the reference count is not atomic, values are used by one thread at a time
+        class CellBase
+        {
+        public:
+            SizeT ref_count = 1;
+        };
+
+        template < typename T >
+        class Cell : public CellBase
+        {
+        public:
+            explicit Cell(const T& v)
+                : value(v)
+            {}
+
+            explicit Cell(T&& v)
+                : value(std::move(v))
+            {}
+
+            T value;
+        };
+
+        // characters of a string value
+        //  - while every character is below 0x100 they take one byte each, short ones fit in the cell itself
+        //  - a string is narrow whenever it can be, so equal strings are always stored the same way
+        //  - a string only changes while a single value holds it, so its hash is computed once per change
+        template < >
+        class Cell<StringT> : public CellBase
+        {
+        public:
+            explicit Cell(const StringT& v)
+            {
+                if (IsNarrow(v.data(), v.size()))
+                {
+                    new (&_narrow) BytesT(v.size(), 0);
+                    NarrowTo(v.data(), v.size(), &_narrow[0]);
+                }
+                else
+                {
+                    new (&_wide_value) StringT(v);
+                    _wide = true;
+                }
+            }
+
+            Cell(const Cell& rhs)
+                : _wide(rhs._wide)
+            {
+                if (_wide)
+                {
+                    new (&_wide_value) StringT(rhs._wide_value);
+                }
+                else
+                {
+                    new (&_narrow) BytesT(rhs._narrow);
+                }
+            }
+
+            ~Cell()
+            {
+                if (_wide)
+                {
+                    _wide_value.~StringT();
+                }
+                else
+                {
+                    _narrow.~BytesT();
+                }
+            }
+
+            Cell& operator=(const Cell&) = delete;
+
+            SizeT Size() const
+            {
+                return _wide ? _wide_value.size() : _narrow.size();
+            }
+
+            CharT At(SizeT index) const
+            {
+                return _wide ? _wide_value[index] : static_cast<unsigned char>(_narrow[index]);
+            }
+
+            StringT Str() const
+            {
+                if (_wide)
+                {
+                    return _wide_value;
+                }
+                StringT s(_narrow.size(), 0);
+                WidenTo(_narrow.data(), _narrow.size(), &s[0]);
+                return s;
+            }
+
+            void Reserve(SizeT size)
+            {
+                if (_wide)
+                {
+                    _wide_value.reserve(size);
+                }
+                else
+                {
+                    _narrow.reserve(size);
+                }
+            }
+
+            void Append(const Cell& rhs)
+            {
+                if (!_wide && !rhs._wide)
+                {
+                    _narrow += rhs._narrow;
+                    return;
+                }
+                Widen();
+                if (rhs._wide)
+                {
+                    _wide_value += rhs._wide_value;
+                }
+                else
+                {
+                    auto size = _wide_value.size();
+                    _wide_value.resize(size + rhs._narrow.size());
+                    WidenTo(rhs._narrow.data(), rhs._narrow.size(), &_wide_value[size]);
+                }
+            }
+
+            void Append(const StringT& v)
+            {
+                if (_wide || !IsNarrow(v.data(), v.size()))
+                {
+                    Widen();
+                    _wide_value += v;
+                    return;
+                }
+                auto size = _narrow.size();
+                _narrow.resize(size + v.size());
+                NarrowTo(v.data(), v.size(), &_narrow[size]);
+            }
+
+            // <0, 0 or >0 like StringT::compare
+            int Compare(const Cell& rhs) const
+            {
+                if (!_wide && !rhs._wide)
+                {
+                    // bytes compare unsigned, the same order as the characters
+                    return _narrow.compare(rhs._narrow);
+                }
+                if (_wide && rhs._wide)
+                {
+                    return _wide_value.compare(rhs._wide_value);
+                }
+                auto size = std::min(Size(), rhs.Size());
+                for (SizeT i = 0; i < size; ++i)
+                {
+                    if (At(i) != rhs.At(i))
+                    {
+                        return At(i) < rhs.At(i) ? -1 : 1;
+                    }
+                }
+                return Size() < rhs.Size() ? -1 : Size() > rhs.Size() ? 1 : 0;
+            }
+
+            bool Equal(const Cell& rhs) const
+            {
+                return _wide == rhs._wide && (_wide ? _wide_value == rhs._wide_value : _narrow == rhs._narrow);
+            }
+
+            SizeT RawHash() const
+            {
+                return _wide ? std::hash<StringT>()(_wide_value) : std::hash<BytesT>()(_narrow);
+            }
+
+            // 0 until computed
+            SizeT hash = 0;
+            // held by the string pool, equal interned strings share this cell
+            bool interned = false;
+
+        private:
+            static bool IsNarrow(const CharT* s, SizeT size)
+            {
+                CharT bits = 0;
+                for (SizeT i = 0; i < size; ++i)
+                {
+                    bits |= s[i];
+                }
+                return bits < 0x100;
+            }
+
+            static void NarrowTo(const CharT* s, SizeT size, ByteT* dst)
+            {
+                for (SizeT i = 0; i < size; ++i)
+                {
+                    dst[i] = static_cast<ByteT>(s[i]);
+                }
+            }
+
+            static void WidenTo(const ByteT* s, SizeT size, CharT* dst)
+            {
+                for (SizeT i = 0; i < size; ++i)
+                {
+                    dst[i] = static_cast<unsigned char>(s[i]);
+                }
+            }
+
+            void Widen()
+            {
+                if (_wide)
+                {
+                    return;
+                }
+                auto wide = Str();
+                _narrow.~BytesT();
+                new (&_wide_value) StringT(std::move(wide));
+                _wide = true;
+            }
+
+        private:
+            bool _wide = false;
+            union {
+                BytesT _narrow;
+                StringT _wide_value;
+            };
+        };
+
+        // nil, bool, int and float are stored inline, other types share a reference counted cell
+        // a value keeps the interface of the shared pointer it replaces : '->', '*' and a null state
         class Data
         {
         public:
@@ -53,6 +304,7 @@ namespace LANG_NS
             {
                 if (
                     _type == EType::Nil
+                    || _type == NullType
                     || (
                         _type == EType::Bool
                         && _value.b == false
@@ -76,61 +328,243 @@ namespace LANG_NS
                 return _value.f;
             }
 
-            const StringT& StringValue() const
+            // strings are stored narrow when they can be, this builds the full string
+            StringT StringValue() const
+            {
+                Assert(_type == EType::String);
+                return StringCell().Str();
+            }
+
+            CharT StringAt(SizeT index) const
+            {
+                Assert(_type == EType::String);
+                return StringCell().At(index);
+            }
+
+            SizeT StringSize() const
             {
                 Assert(_type == EType::String);
-                return *_value.s;
+                return StringCell().Size();
+            }
+
+            // <0, 0 or >0 like StringT::compare, both values must be strings
+            int CompareString(const Data& rhs) const
+            {
+                Assert(_type == EType::String && rhs._type == EType::String);
+                return StringCell().Compare(rhs.StringCell());
+            }
+
+            // left followed by right, right as it prints when it is no string
+            static Data ConcatString(const Data& left, const Data& right)
+            {
+                Assert(left._type == EType::String);
+                Data result;
+                result._type = EType::String;
+                auto cell = new Cell<StringT>(left.StringCell());
+                result._value.cell = cell;
+                if (right._type == EType::String)
+                {
+                    cell->Reserve(cell->Size() + right.StringCell().Size());
+                    cell->Append(right.StringCell());
+                }
+                else
+                {
+                    cell->Append(right.ToString());
+                }
+                return result;
+            }
+
+            // the string repeated count times
+            Data RepeatString(SizeT count) const
+            {
+                Assert(_type == EType::String && count > 0);
+                Data result;
+                result._type = EType::String;
+                auto cell = new Cell<StringT>(StringCell());
+                result._value.cell = cell;
+                cell->Reserve(cell->Size() * count);
+                for (SizeT i = 1; i < count; ++i)
+                {
+                    cell->Append(StringCell());
+                }
+                return result;
+            }
+
+            // appends v in place when this value holds the only reference to a string that is not interned,
+            // v is appended as it prints when it is no string
+            bool AppendString(const Data& v)
+            {
+                if (_type != EType::String || _value.cell->ref_count != 1 || IsInterned())
+                {
+                    return false;
+                }
+                auto& cell = StringCell();
+                if (v._type == EType::String)
+                {
+                    cell.Append(v.StringCell());
+                }
+                else
+                {
+                    cell.Append(v.ToString());
+                }
+                cell.hash = 0;
+                return true;
             }
 
             const ArrayT& ArrayValue() const
             {
                 Assert(_type == EType::Array);
-                return *(*_value.a);
+                return CellValue<ArrayT>();
             }
 
             const DictT& DictValue() const
             {
                 Assert(_type == EType::Dict);
-                return *(*_value.d);
+                return CellValue<DictT>();
             }
 
-            void SetArrayValue(SizeT index, ValuePtr val)
+            void SetArrayValue(SizeT index, ValuePtr val) const
             {
-                if (index >= (*_value.a)->size())
+                auto& array_data = CellValue<ArrayT>();
+                if (index >= array_data.size())
                 {
-                    (*_value.a)->resize(index + 1);
+                    array_data.resize(index + 1);
                 }
-                (*(*_value.a))[index] = val;
+                array_data[index] = std::move(val);
+            }
+
+            void RemoveArrayValue(SizeT index, SizeT count) const
+            {
+                auto& array_data = CellValue<ArrayT>();
+                Assert(index + count <= array_data.size());
+                array_data.erase(array_data.begin() + index, array_data.begin() + index + count);
             }
 
-            void RemoveArrayValue(SizeT index, SizeT count)
+            void InsertArrayValue(SizeT index, ValuePtr val) const
             {
-                Assert(index + count <= (*_value.a)->size());
-                (*_value.a)->erase((*_value.a)->begin() + index, (*_value.a)->begin() + index + count);
+                auto& array_data = CellValue<ArrayT>();
+                Assert(index <= array_data.size());
+                array_data.insert(array_data.begin() + index, std::move(val));
             }
 
-            void InsertArrayValue(SizeT index, const ValuePtr& val)
+            void SetDictValue(const Value::Data& key, ValuePtr val) const
             {
-                Assert(index <= (*_value.a)->size());
-                (*_value.a)->insert((*_value.a)->begin() + index, val);
+                if (val.GetType() == EType::Nil)
+                {
+                    CellValue<DictT>().erase(key);
+                }
+                else
+                {
+                    CellValue<DictT>()[key] = std::move(val);
+                }
             }
 
-            void SetDictValue(const Value::Data& key, ValuePtr val)
+            void SetDictValue(Value::Data&& key, ValuePtr val) const
             {
-                if (val->GetType() == EType::Nil)
+                if (val.GetType() == EType::Nil)
                 {
-                    (*(*_value.d)).erase(key);
+                    CellValue<DictT>().erase(key);
                 }
                 else
                 {
-                    (*(*_value.d))[key] = val;
+                    CellValue<DictT>()[std::move(key)] = std::move(val);
                 }
             }
 
+            const RangeT& RangeValue() const
+            {
+                Assert(_type == EType::Range);
+                return CellValue<RangeT>();
+            }
+
+            bool IsTypedArray() const
+            {
+                return _type == EType::IntArray || _type == EType::FloatArray;
+            }
+
+            const IntArrayT& IntArrayValue() const
+            {
+                Assert(_type == EType::IntArray);
+                return CellValue<IntArrayT>();
+            }
+
+            IntArrayT& IntArrayValue()
+            {
+                Assert(_type == EType::IntArray);
+                return CellValue<IntArrayT>();
+            }
+
+            const FloatArrayT& FloatArrayValue() const
+            {
+                Assert(_type == EType::FloatArray);
+                return CellValue<FloatArrayT>();
+            }
+
+            FloatArrayT& FloatArrayValue()
+            {
+                Assert(_type == EType::FloatArray);
+                return CellValue<FloatArrayT>();
+            }
+
+            SizeT TypedArraySize() const
+            {
+                Assert(IsTypedArray());
+                return _type == EType::IntArray ? CellValue<IntArrayT>().size() : CellValue<FloatArrayT>().size();
+            }
+
+            // nil past the end
+            Data TypedArrayAt(SizeT index) const
+            {
+                if (index >= TypedArraySize())
+                {
+                    return Data();
+                }
+                if (_type == EType::IntArray)
+                {
+                    return Data(CellValue<IntArrayT>()[index]);
+                }
+                return Data(CellValue<FloatArrayT>()[index]);
+            }
+
+            // grows the array with zeros like SetArrayValue grows with nils, an int array only takes ints
+            void SetTypedArrayValue(SizeT index, const Data& val) const
+            {
+                if (_type == EType::IntArray)
+                {
+                    if (val._type != EType::Int)
+                    {
+                        throw(Exception(U"Assign value of int_array must be a interger"));
+                    }
+                    auto& array_data = CellValue<IntArrayT>();
+                    if (index >= array_data.size())
+                    {
+                        array_data.resize(index + 1);
+                    }
+                    array_data[index] = val._value.i;
+                    return;
+                }
+                if (val._type != EType::Int && val._type != EType::Float)
+                {
+                    throw(Exception(U"Assign value of float_array must be a number"));
+                }
+                auto& array_data = CellValue<FloatArrayT>();
+                if (index >= array_data.size())
+                {
+                    array_data.resize(index + 1);
+                }
+                array_data[index] = val._type == EType::Int ? static_cast<FloatT>(val._value.i) : val._value.f;
+            }
+
+            // no other value shares the cell, so it may be changed in place
+            bool UniquelyHeld() const
+            {
+                return IsCell() && _value.cell->ref_count == 1;
+            }
+
             const FunctionT& FunctionValue() const
             {
                 Assert(_type == EType::Function);
-                return *(*_value.fn);
+                return CellValue<FunctionT>();
             }
 
             StringT ToString() const
@@ -153,19 +587,31 @@ namespace LANG_NS
                 }
                 else if (_type == EType::String)
                 {
-                    return *_value.s;
+                    return StringCell().Str();
                 }
                 else if (_type == EType::Array)
                 {
-                    return StringT(U"Array : ") + LANG_NS::ToString((*_value.a).get());
+                    return StringT(U"Array : ") + LANG_NS::ToString(&CellValue<ArrayT>());
                 }
                 else if (_type == EType::Dict)
                 {
-                    return StringT(U"Dict : ") + LANG_NS::ToString((*_value.d).get());
+                    return StringT(U"Dict : ") + LANG_NS::ToString(&CellValue<DictT>());
                 }
                 else if (_type == EType::Function)
                 {
-                    return StringT(U"Function : ") + LANG_NS::ToString((*_value.fn).get());
+                    return StringT(U"Function : ") + LANG_NS::ToString(&CellValue<FunctionT>());
+                }
+                else if (_type == EType::IntArray)
+                {
+                    return StringT(U"IntArray : ") + LANG_NS::ToString(&CellValue<IntArrayT>());
+                }
+                else if (_type == EType::FloatArray)
+                {
+                    return StringT(U"FloatArray : ") + LANG_NS::ToString(&CellValue<FloatArrayT>());
+                }
+                else if (_type == EType::Range)
+                {
+                    return StringT(U"Range : ") + LANG_NS::ToString(&CellValue<RangeT>());
                 }
                 return U"<unknown>";
             }
@@ -200,22 +646,121 @@ namespace LANG_NS
                 }
                 else if (_type == EType::String)
                 {
-                    return *(_value.s) < *(rhs._value.s);
+                    return _value.cell != rhs._value.cell && StringCell().Compare(rhs.StringCell()) < 0;
                 }
-                else if (_type == EType::Array)
+                else if (IsCell())
                 {
-                    return (*_value.a).get() < (*rhs._value.a).get();
+                    return _value.cell < rhs._value.cell;
                 }
-                else if (_type == EType::Dict)
+                return false;
+            }
+
+            bool operator==(const Data& rhs) const
+            {
+                if (_type != rhs._type)
                 {
-                    return (*_value.d).get() < (*rhs._value.d).get();
+                    return false;
                 }
-                else if (_type == EType::Function)
+                if (_type == EType::Bool)
                 {
-                    return (*_value.fn).get() < (*rhs._value.fn).get();
+                    return _value.b == rhs._value.b;
                 }
-                return false;
+                else if (_type == EType::Int)
+                {
+                    return _value.i == rhs._value.i;
+                }
+                else if (_type == EType::Float)
+                {
+                    return _value.f == rhs._value.f;
+                }
+                else if (_type == EType::String)
+                {
+                    if (_value.cell == rhs._value.cell)
+                    {
+                        return true;
+                    }
+                    if (IsInterned() && rhs.IsInterned())
+                    {
+                        return false;
+                    }
+                    return Hash() == rhs.Hash() && StringCell().Equal(rhs.StringCell());
+                }
+                else if (IsCell())
+                {
+                    return _value.cell == rhs._value.cell;
+                }
+                return true;
+            }
+
+            // the shared copy of a string, used for names and literals
+            static Data Intern(const StringT& s);
+
+            // equal values have equal hashes, arrays, dicts and functions hash by identity
+            SizeT Hash() const
+            {
+                if (_type == EType::String)
+                {
+                    auto& cell = StringCell();
+                    if (cell.hash == 0)
+                    {
+                        cell.hash = Mix(cell.RawHash()) | 1;
+                    }
+                    return cell.hash;
+                }
+                if (_type == EType::Bool)
+                {
+                    return Mix(_value.b ? 1 : 2);
+                }
+                else if (_type == EType::Int)
+                {
+                    return Mix(static_cast<SizeT>(_value.i));
+                }
+                else if (_type == EType::Float)
+                {
+                    // 0.0 and -0.0 are equal
+                    return _value.f == 0 ? Mix(3) : Mix(std::hash<FloatT>()(_value.f));
+                }
+                else if (IsCell())
+                {
+                    return Mix(reinterpret_cast<SizeT>(_value.cell));
+                }
+                return 0;
+            }
+
+            // handle interface
+            const Data* operator->() const
+            {
+                return this;
+            }
+
+            Data* operator->()
+            {
+                return this;
             }
+
+            const Data& operator*() const
+            {
+                return *this;
+            }
+
+            Data& operator*()
+            {
+                return *this;
+            }
+
+            // false for a null handle, which is not the nil value
+            explicit operator bool() const
+            {
+                return _type != NullType;
+            }
+
+            void reset()
+            {
+                Release();
+                _type = NullType;
+                _value.i = 0;
+            }
+
         public:
             Data()
                 : _type(EType::Nil)
@@ -223,9 +768,16 @@ namespace LANG_NS
                 _value.i = 0;
             }
 
+            Data(const NullptrT)
+                : _type(NullType)
+            {
+                _value.i = 0;
+            }
+
             Data(const BoolT b)
                 : _type(EType::Bool)
             {
+                _value.i = 0;
                 _value.b = b;
             }
 
@@ -280,39 +832,76 @@ namespace LANG_NS
             Data(const CharT * s)
                 : _type(EType::String)
             {
-                _value.s = new StringT;
-                *(_value.s) = s;
+                _value.cell = new Cell<StringT>(s);
             }
 
             Data(const StringT& s)
                 : _type(EType::String)
             {
-                _value.s = new StringT;
-                *(_value.s) = s;
+                _value.cell = new Cell<StringT>(s);
             }
 
             Data(const ArrayT& a)
                 : _type(EType::Array)
             {
-                _value.a = new SharedPtr<ArrayT>;
-                *(_value.a) = MakeShared<ArrayT>(a);
+                _value.cell = new Cell<ArrayT>(a);
+            }
+
+            Data(ArrayT&& a)
+                : _type(EType::Array)
+            {
+                _value.cell = new Cell<ArrayT>(std::move(a));
             }
 
             Data(const DictT& d)
                 : _type(EType::Dict)
             {
-                _value.d = new SharedPtr<DictT>;
-                *(_value.d) = MakeShared<DictT>(d);
+                _value.cell = new Cell<DictT>(d);
+            }
+
+            Data(DictT&& d)
+                : _type(EType::Dict)
+            {
+                _value.cell = new Cell<DictT>(std::move(d));
             }
 
             Data(const FunctionT& fn)
                 : _type(EType::Function)
             {
-                _value.fn = new SharedPtr<FunctionT>;
-                *(_value.fn) = MakeShared<FunctionT>(fn);
+                _value.cell = new Cell<FunctionT>(fn);
+            }
+
+            Data(const IntArrayT& a)
+                : _type(EType::IntArray)
+            {
+                _value.cell = new Cell<IntArrayT>(a);
+            }
+
+            Data(IntArrayT&& a)
+                : _type(EType::IntArray)
+            {
+                _value.cell = new Cell<IntArrayT>(std::move(a));
+            }
+
+            Data(const FloatArrayT& a)
+                : _type(EType::FloatArray)
+            {
+                _value.cell = new Cell<FloatArrayT>(a);
             }
 
-            Data(const SharedPtr<TokenT> token)
+            Data(FloatArrayT&& a)
+                : _type(EType::FloatArray)
+            {
+                _value.cell = new Cell<FloatArrayT>(std::move(a));
+            }
+
+            Data(const RangeT& r)
+                : _type(EType::Range)
+            {
+                _value.cell = new Cell<RangeT>(r);
+            }
+
+            Data(const TokenT* token)
             {
                 if (token->GetType() == ETokenType::Nil)
                 {
@@ -322,6 +911,7 @@ namespace LANG_NS
                 else if (token->GetType() == ETokenType::Bool)
                 {
                     _type = EType::Bool;
+                    _value.i = 0;
                     _value.b = token->BoolValue();
                 }
                 else if (token->GetType() == ETokenType::Int)
@@ -336,9 +926,9 @@ namespace LANG_NS
                 }
                 else if (token->GetType() == ETokenType::String)
                 {
-                    _type = EType::String;
-                    _value.s = new StringT;
-                    *_value.s = token->StringValue();
+                    _type = EType::Nil;
+                    _value.i = 0;
+                    *this = Intern(token->StringValue());
                 }
                 else
                 {
@@ -348,71 +938,120 @@ namespace LANG_NS
 
             Data(const Data& rhs)
                 : _type(rhs._type)
+                , _value(rhs._value)
             {
-                if (_type == EType::Nil)
+                if (IsCell())
                 {
-                    _value.i = 0;
+                    ++_value.cell->ref_count;
                 }
-                else if (_type == EType::Bool)
+            }
+
+            Data(Data&& rhs) noexcept
+                : _type(rhs._type)
+                , _value(rhs._value)
+            {
+                rhs._type = EType::Nil;
+                rhs._value.i = 0;
+            }
+
+            Data& operator=(const Data& rhs)
+            {
+                if (rhs.IsCell())
                 {
-                    _value.b = rhs._value.b;
+                    ++rhs._value.cell->ref_count;
                 }
-                else if (_type == EType::Int)
+                Release();
+                _type = rhs._type;
+                _value = rhs._value;
+                return *this;
+            }
+
+            Data& operator=(Data&& rhs) noexcept
+            {
+                if (this != &rhs)
                 {
-                    _value.i = rhs._value.i;
+                    Release();
+                    _type = rhs._type;
+                    _value = rhs._value;
+                    rhs._type = EType::Nil;
+                    rhs._value.i = 0;
                 }
-                else if (_type == EType::Float)
+                return *this;
+            }
+
+            ~Data()
+            {
+                Release();
+            }
+
+        private:
+            static constexpr EType NullType = static_cast<EType>(-1);
+
+            // spreads the bits of a hash over the low bits the dict index uses
+            static SizeT Mix(SizeT h)
+            {
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdULL;
+                h ^= h >> 33;
+                return h;
+            }
+
+            bool IsCell() const
+            {
+                return _type >= EType::String;
+            }
+
+            bool IsInterned() const
+            {
+                return StringCell().interned;
+            }
+
+            Cell<StringT>& StringCell() const
+            {
+                return *static_cast<Cell<StringT>*>(_value.cell);
+            }
+
+            template < typename T >
+            T& CellValue() const
+            {
+                return static_cast<Cell<T>*>(_value.cell)->value;
+            }
+
+            void Release()
+            {
+                if (!IsCell() || --_value.cell->ref_count > 0)
                 {
-                    _value.f = rhs._value.f;
+                    return;
                 }
-                else if (_type == EType::String)
+                if (_type == EType::String)
                 {
-                    _value.s = new StringT;
-                    *(_value.s) = *(rhs._value.s);
+                    delete static_cast<Cell<StringT>*>(_value.cell);
                 }
                 else if (_type == EType::Array)
                 {
-                    _value.a = new SharedPtr<ArrayT>;
-                    (*_value.a) = *(rhs._value.a);
+                    delete static_cast<Cell<ArrayT>*>(_value.cell);
                 }
                 else if (_type == EType::Dict)
                 {
-                    _value.d = new SharedPtr<DictT>;
-                    (*_value.d) = *(rhs._value.d);
+                    delete static_cast<Cell<DictT>*>(_value.cell);
                 }
                 else if (_type == EType::Function)
                 {
-                    _value.fn = new SharedPtr<FunctionT>;
-                    *(_value.fn) = *(rhs._value.fn);
+                    delete static_cast<Cell<FunctionT>*>(_value.cell);
                 }
-                else
+                else if (_type == EType::IntArray)
                 {
-                    throw(Exception(U"Invalid Value::Data"));
+                    delete static_cast<Cell<IntArrayT>*>(_value.cell);
                 }
-            }
-
-            ~Data()
-            {
-                if (_type == EType::String)
+                else if (_type == EType::FloatArray)
                 {
-                    delete _value.s;
-                    _value.s = nullptr;
+                    delete static_cast<Cell<FloatArrayT>*>(_value.cell);
                 }
-                else if (_type == EType::Array)
+                else if (_type == EType::Range)
                 {
-                    delete _value.a;
-                    _value.a = nullptr;
-                }
-                else if (_type == EType::Dict)
-                {
-                    delete _value.d;
-                    _value.d = nullptr;
-                }
-                else if (_type == EType::Function)
-                {
-                    delete _value.fn;
-                    _value.fn = nullptr;
+                    delete static_cast<Cell<RangeT>*>(_value.cell);
                 }
+                _value.cell = nullptr;
             }
 
         private:
@@ -421,22 +1060,56 @@ namespace LANG_NS
                 BoolT b;
                 IntT i;
                 FloatT f;
-                StringT* s;
-                SharedPtr<ArrayT>* a;
-                SharedPtr<DictT>* d;
-                SharedPtr<FunctionT>* fn;
+                CellBase* cell;
             } _value;
         };
+        StaticAssert(sizeof(Data) == 16, "Value::Data must be 16 bytes");
+
+        // every distinct interned string, kept for the life of the process
+        class StringPool : NoCopyable
+        {
+        public:
+            static StringPool& GetInstance()
+            {
+                static StringPool _instance;
+                return _instance;
+            }
+
+            // the interned string equal to s, nil if there is none yet
+            Data& Find(const StringT& s)
+            {
+                return _strings[s];
+            }
+
+            SizeT Size() const
+            {
+                return _strings.size();
+            }
+
+        private:
+            std::unordered_map<StringT, Data> _strings;
+        };
+
+        inline Data Data::Intern(const StringT& s)
+        {
+            auto& interned = StringPool::GetInstance().Find(s);
+            if (interned.GetType() != EType::String)
+            {
+                interned = Data(s);
+                static_cast<Cell<StringT>*>(interned._value.cell)->interned = true;
+            }
+            return interned;
+        }
 
-        static SharedPtr<Data> New()
+        static Data New()
         {
-            return MakeShared<Data>();
+            return Data();
         }
 
         template < typename T >
-        SharedPtr<Data> New(const T v)
+        Data New(const T v)
         {
-            return MakeShared<Data>(v);
+            return Data(v);
         }
     }
 
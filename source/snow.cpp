@@ -1,5 +1,10 @@
 #include "environment.h"
+#include "repl.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <thread>
 using namespace std;
 using namespace LANG_NS;
 
@@ -17,40 +22,118 @@ int RunFromFile(Environment& env, const BytesT& file_name, const ValuePtrList& p
 
 int RunCommand(Environment& env)
 {
-    BytesT buffer;
+    Repl repl(env);
+    BytesT cmd;
     do
     {
-        BytesT cmd;
-        if (!buffer.empty())
+        if (repl.Pending())
         {
             cout << ">";
         }
         cout << "> ";
-        getline(cin, cmd);
+        if (!getline(cin, cmd))
+        {
+            repl.Flush();
+            break;
+        }
         if (cmd == "quit")
         {
             break;
         }
 
-        if (cmd.empty())
+        if (cmd.empty() && !repl.Pending())
+        {
+            continue;
+        }
+        repl.Feed(Unicode::Decode(cmd));
+    } while (true);
+    return 0;
+}
+
+TVector<Diagnostic> CheckFile(const BytesT& file_name)
+{
+    // the reader takes a missing file for an empty one
+    if (!std::ifstream(file_name, std::ios_base::in | std::ios_base::binary).is_open())
+    {
+        return {Diagnostic{0, 0, U"Cannot open file"}};
+    }
+    try
+    {
+        auto reader = MakeShared<Unicode::FileReader>(Unicode::Decode(file_name));
+        auto scanner = MakeShared<Scanner>(reader);
+        Parser parser(scanner, true);
+        (void)parser.Parse();
+        return parser.Diagnostics();
+    }
+    catch (const Exception& e)
+    {
+        return {Diagnostic{0, 0, e.Info()}};
+    }
+    // anything else must not take down the other files being checked
+    catch (const std::exception& e)
+    {
+        BytesT what = e.what();
+        return {Diagnostic{0, 0, StringT(U"Internal error: ") + StringT(what.begin(), what.end())}};
+    }
+}
+
+// parse every script under the paths without running anything, files are shared out to one thread per core
+int RunCheck(const TVector<BytesT>& paths)
+{
+    namespace fs = std::filesystem;
+    TVector<BytesT> files;
+    for (auto iter = paths.begin(); iter != paths.end(); ++iter)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(*iter, ec))
         {
+            files.push_back(*iter);
             continue;
         }
+        for (fs::recursive_directory_iterator dir(*iter, ec), end; !ec && dir != end; dir.increment(ec))
+        {
+            if (dir->is_regular_file(ec) && dir->path().extension() == LANG_EXT_NAME)
+            {
+                files.push_back(dir->path().string());
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
 
-        bool run = true;
-        if (cmd[cmd.size() - 1] == ':')
+    TVector<TVector<Diagnostic>> results(files.size());
+    std::atomic<SizeT> next(0);
+    auto worker = [&]()
+    {
+        for (SizeT i = next++; i < files.size(); i = next++)
         {
-            cmd[cmd.size() - 1] = '\n';
-            run = false;
+            results[i] = CheckFile(files[i]);
         }
-        buffer += cmd;
-        if (run)
+    };
+    auto thread_count = std::min<SizeT>(std::max(std::thread::hardware_concurrency(), 1u), files.size());
+    TVector<std::thread> threads;
+    for (SizeT i = 1; i < thread_count; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto iter = threads.begin(); iter != threads.end(); ++iter)
+    {
+        iter->join();
+    }
+
+    SizeT error_count = 0;
+    SizeT error_file_count = 0;
+    for (SizeT i = 0; i < files.size(); ++i)
+    {
+        for (auto iter = results[i].begin(); iter != results[i].end(); ++iter)
         {
-            RunFromString(env, buffer, {});
-            buffer.clear();
+            cout << files[i] << ":" << iter->line << ":" << iter->column << ": " << iter->message << endl;
         }
-    } while (true);
-    return 0;
+        error_count += results[i].size();
+        error_file_count += results[i].empty() ? 0 : 1;
+    }
+    cout << files.size() << " files checked, " << error_count << " errors in " << error_file_count << " files" << endl;
+    return error_count == 0 ? 0 : 1;
 }
 
 int main(int argc, char** argv)
@@ -62,7 +145,16 @@ int main(int argc, char** argv)
     }
     else if (argc >= 2)
     {
-        if (strcmp(argv[1], "-e") == 0)
+        if (strcmp(argv[1], "check") == 0)
+        {
+            if (argc == 2)
+            {
+                cout << "need files or directories after check!!!";
+                return 0;
+            }
+            return RunCheck(TVector<BytesT>(argv + 2, argv + argc));
+        }
+        else if (strcmp(argv[1], "-e") == 0)
         {
             if (argc == 2)
             {